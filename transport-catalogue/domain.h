@@ -1,29 +1,32 @@
 #pragma once
-#include <string>
+#include <string_view>
 #include <vector>
 #include "geo.h"
 
 namespace domain {
 
+    // Названия остановок и маршрутов хранятся в NameArena каталога
     struct Stop {
-        std::string name;
+        std::string_view name;
         geo::Coordinates coordinates;
+        size_t id = 0;
     };
 
     struct Bus {
-        std::string name;
-        bool is_rounded;
+        std::string_view name;
+        bool is_rounded = false;
         std::vector<const Stop*> route;
-        double distance_real;
-        double distance_ideal;
+        double distance_real = 0.0;
+        double distance_ideal = 0.0;
+        size_t id = 0;
     };
 
     struct Statistics {
-        bool found;
-        bool is_rounded;
-        size_t stops_count;
-        size_t unique_stops_count;
-        double distance;
-        double curvature;
+        bool found = false;
+        bool is_rounded = false;
+        size_t stops_count = 0;
+        size_t unique_stops_count = 0;
+        double distance = 0.0;
+        double curvature = 0.0;
     };
 } // namespace domain
@@ -1,4 +1,10 @@
 #include "json.h"
+#include "json_simd.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 #include <sstream>
 
 using namespace std;
@@ -7,124 +13,192 @@ namespace json {
 
     namespace {
 
-        void CheckInputStream(istream& input) {
-            auto it = std::istreambuf_iterator<char>(input);
-            auto end = std::istreambuf_iterator<char>();
-            if (it == end) {
-                throw ParsingError("Parsing error");
+        using Number = std::variant<int, double>;
+
+        Number ConvertNumber(const char* begin, const char* end, bool is_int) {
+            if (is_int) {
+                // Сначала пробуем преобразовать в int. При переполнении
+                // код ниже попробует преобразовать число в double
+                int value = 0;
+                if (const auto result = std::from_chars(begin, end, value); result.ec == std::errc() && result.ptr == end) {
+                    return value;
+                }
+            }
+            double value = 0;
+            if (const auto result = std::from_chars(begin, end, value); result.ec == std::errc() && result.ptr == end) {
+                return value;
             }
+            throw ParsingError("Failed to convert "s + string(begin, end) + " to number"s);
         }
 
-        Node LoadNode(istream& input);
+        /*
+         * Общие для всех разборщиков примитивы: движение указателем по непрерывному буферу.
+         * Поток читается блоками в буфер ограниченного размера: когда pos_ доходит до конца блока,
+         * непрочитанный хвост переносится в начало буфера и дочитывается следующий блок
+         */
+        class Scanner {
+        public:
+            explicit Scanner(std::string_view input)
+                : pos_(input.data()),
+                end_(input.data() + input.size())
+            {
+            }
 
-        Node LoadNull(istream& input) {
-            CheckInputStream(input);
-            string word;
-            for (char c; input >> c && c != ',';) {
-                word.push_back(c);
+            explicit Scanner(std::istream& input)
+                : input_(&input),
+                buffer_(BUFFER_SIZE, '\0')
+            {
+                pos_ = end_ = buffer_.data();
             }
-            if (word != "null"s) {
-                throw ParsingError("The uploaded text is not null"s);
+
+        protected:
+            const char* pos_;
+            const char* end_;
+            // Начало читаемого числа: при дочитывании оно сохраняется в буфере вместе с хвостом
+            const char* mark_ = nullptr;
+
+            static bool IsDigit(char c) {
+                return c >= '0' && c <= '9';
             }
-            return Node(nullptr);
-        }
 
-        Node LoadNumber(std::istream& input) {
-            CheckInputStream(input);
-            using namespace std::literals;
-            std::string parsed_num;
-            // Считывает в parsed_num очередной символ из input
-            auto read_char = [&parsed_num, &input] {
-                parsed_num += static_cast<char>(input.get());
-                if (!input) {
-                    throw ParsingError("Failed to read number from stream"s);
-                }
-            };
+            // true, если вход закончился. Проверка дешёвая: поток дочитывается, только когда блок пройден целиком
+            bool AtEnd() {
+                return pos_ == end_ && !Refill();
+            }
 
-            // Считывает одну или более цифр в parsed_num из input
-            auto read_digits = [&input, read_char] {
-                if (!std::isdigit(input.peek())) {
-                    throw ParsingError("A digit is expected"s);
+            /*
+             * Дочитывает следующий блок потока; false, если вход закончился. Непрочитанный хвост
+             * и начатое число переносятся в начало буфера, поэтому указатели на пройденный текст
+             * после вызова недействительны
+             */
+            bool Refill() {
+                if (input_ == nullptr) {
+                    return false;
+                }
+                char* data = buffer_.data();
+                const char* keep = mark_ != nullptr ? mark_ : pos_;
+                const size_t kept = static_cast<size_t>(end_ - keep);
+                const size_t pos_offset = static_cast<size_t>(pos_ - keep);
+                std::memmove(data, keep, kept);
+                if (kept == buffer_.size()) {
+                    // Хвост занял весь буфер (число длиннее блока): буфер растёт
+                    buffer_.resize(buffer_.size() * 2);
+                    data = buffer_.data();
                 }
-                while (std::isdigit(input.peek())) {
-                    read_char();
+                input_->read(data + kept, static_cast<std::streamsize>(buffer_.size() - kept));
+                const size_t count = static_cast<size_t>(input_->gcount());
+                pos_ = data + pos_offset;
+                end_ = data + kept + count;
+                if (mark_ != nullptr) {
+                    mark_ = data;
                 }
-            };
+                return count != 0;
+            }
 
-            if (input.peek() == '-') {
-                read_char();
+            // Дочитывает поток, пока после pos_ не окажется count символов; false, если вход кончился раньше
+            bool Has(size_t count) {
+                while (static_cast<size_t>(end_ - pos_) < count) {
+                    if (!Refill()) {
+                        return false;
+                    }
+                }
+                return true;
             }
-            // Парсим целую часть числа
-            if (input.peek() == '0') {
-                read_char();
-                // После 0 в JSON не могут идти другие цифры
+
+            void SkipWhitespace() {
+                // Чаще всего значимый символ идёт сразу или после одного пробела: блоками ищем только длинные отступы
+                if (!AtEnd() && simd::IsSpace(*pos_)) {
+                    ++pos_;
+                    if (!AtEnd() && simd::IsSpace(*pos_)) {
+                        pos_ = simd::SkipSpaces(pos_, end_);
+                        while (pos_ == end_ && Refill()) {
+                            pos_ = simd::SkipSpaces(pos_, end_);
+                        }
+                    }
+                }
             }
-            else {
-                read_digits();
+
+            void ExpectEnd() {
+                SkipWhitespace();
+                if (!AtEnd()) {
+                    throw ParsingError("Unexpected characters after the end of document"s);
+                }
             }
 
-            bool is_int = true;
-            // Парсим дробную часть числа
-            if (input.peek() == '.') {
-                read_char();
-                read_digits();
-                is_int = false;
+            // Возвращает первый непробельный символ, не сдвигаясь с него
+            char PeekToken() {
+                SkipWhitespace();
+                if (AtEnd()) {
+                    throw ParsingError("Unexpected end of input"s);
+                }
+                return *pos_;
             }
 
-            // Парсим экспоненциальную часть числа
-            if (int ch = input.peek(); ch == 'e' || ch == 'E') {
-                read_char();
-                if (ch = input.peek(); ch == '+' || ch == '-') {
-                    read_char();
+            void Expect(char c) {
+                if (PeekToken() != c) {
+                    throw ParsingError("Expected '"s + c + "'"s);
                 }
-                read_digits();
-                is_int = false;
+                ++pos_;
             }
 
-            try {
-                if (is_int) {
-                    // Сначала пробуем преобразовать строку в int
-                    try {
-                        return Node(std::stoi(parsed_num));
-                    }
-                    catch (...) {
-                        // В случае неудачи, например, при переполнении,
-                        // код ниже попробует преобразовать строку в double
-                    }
+            void ExpectWord(std::string_view word) {
+                if (!Has(word.size()) || std::string_view(pos_, word.size()) != word) {
+                    throw ParsingError("Unexpected literal"s);
                 }
-                return Node(std::stod(parsed_num));
+                pos_ += word.size();
             }
-            catch (...) {
-                throw ParsingError("Failed to convert "s + parsed_num + " to number"s);
+
+            // После очередного элемента массива или словаря: true, если контейнер закончился
+            bool ReadSeparator(char close) {
+                const char c = PeekToken();
+                ++pos_;
+                if (c == close) {
+                    return true;
+                }
+                if (c != ',') {
+                    throw ParsingError("Expected ',' or '"s + close + "'"s);
+                }
+                return false;
             }
-        }
 
-        Node LoadString(std::istream& input) {
-            CheckInputStream(input);
-            using namespace std::literals;
-            auto it = std::istreambuf_iterator<char>(input);
-            auto end = std::istreambuf_iterator<char>();
-            std::string s;
-            while (true) {
-                if (it == end) {
-                    // Поток закончился до того, как встретили закрывающую кавычку?
-                    throw ParsingError("String parsing error");
-                }
-                const char ch = *it;
-                if (ch == '"') {
-                    // Встретили закрывающую кавычку
-                    ++it;
-                    break;
+            // Пустой контейнер закрывается сразу после открывающей скобки
+            bool ReadEmptyContainer(char close) {
+                ++pos_;
+                if (PeekToken() == close) {
+                    ++pos_;
+                    return true;
                 }
-                else if (ch == '\\') {
-                    // Встретили начало escape-последовательности
-                    ++it;
-                    if (it == end) {
-                        // Поток завершился сразу после символа обратной косой черты
-                        throw ParsingError("String parsing error");
+                return false;
+            }
+
+            // pos_ указывает на открывающую кавычку, результат дописывается в s
+            template <typename Str>
+            void ReadString(Str& s) {
+                ++pos_;
+                while (true) {
+                    // Участок без кавычек и escape-последовательностей копируется целиком
+                    const char* chunk_begin = pos_;
+                    pos_ = simd::FindStringStop(pos_, end_);
+                    s.append(chunk_begin, pos_);
+                    if (pos_ == end_) {
+                        if (!Refill()) {
+                            // Поток закончился до того, как встретили закрывающую кавычку
+                            throw ParsingError("String parsing error"s);
+                        }
+                        continue;
                     }
-                    const char escaped_char = *(it);
-                    // Обрабатываем одну из последовательностей: \\, \n, \t, \r, \"
+                    const char ch = *pos_++;
+                    if (ch == '"') {
+                        break;
+                    }
+                    if (ch != '\\') {
+                        // Строковый литерал внутри JSON не может прерываться символами \r или \n
+                        throw ParsingError("Unexpected end of line"s);
+                    }
+                    if (AtEnd()) {
+                        throw ParsingError("String parsing error"s);
+                    }
+                    const char escaped_char = *pos_++;
                     switch (escaped_char) {
                     case 'n':
                         s.push_back('\n');
@@ -135,114 +209,639 @@ namespace json {
                     case 'r':
                         s.push_back('\r');
                         break;
-                    case '"':
-                        s.push_back('"');
+                    case 'b':
+                        s.push_back('\b');
+                        break;
+                    case 'f':
+                        s.push_back('\f');
                         break;
+                    case '"':
                     case '\\':
-                        s.push_back('\\');
+                    case '/':
+                        s.push_back(escaped_char);
+                        break;
+                    case 'u':
+                        AppendCodePoint(ReadCodePoint(), s);
                         break;
                     default:
                         // Встретили неизвестную escape-последовательность
                         throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
                     }
                 }
-                else if (ch == '\n' || ch == '\r') {
-                    // Строковый литерал внутри- JSON не может прерываться символами \r или \n
-                    throw ParsingError("Unexpected end of line"s);
+            }
+
+            uint32_t ReadHex4() {
+                if (!Has(4)) {
+                    throw ParsingError("String parsing error"s);
+                }
+                uint32_t code = 0;
+                for (int i = 0; i < 4; ++i) {
+                    const char c = *pos_++;
+                    code <<= 4;
+                    if (IsDigit(c)) {
+                        code |= c - '0';
+                    }
+                    else if (c >= 'a' && c <= 'f') {
+                        code |= c - 'a' + 10;
+                    }
+                    else if (c >= 'A' && c <= 'F') {
+                        code |= c - 'A' + 10;
+                    }
+                    else {
+                        throw ParsingError("Invalid \\u escape sequence"s);
+                    }
+                }
+                return code;
+            }
+
+            // Суррогатная пара из двух последовательностей склеивается в один символ
+            uint32_t ReadCodePoint() {
+                const uint32_t code = ReadHex4();
+                if (code < 0xD800 || code > 0xDBFF) {
+                    return code;
+                }
+                if (!Has(2) || pos_[0] != '\\' || pos_[1] != 'u') {
+                    throw ParsingError("Invalid surrogate pair"s);
+                }
+                pos_ += 2;
+                const uint32_t low = ReadHex4();
+                if (low < 0xDC00 || low > 0xDFFF) {
+                    throw ParsingError("Invalid surrogate pair"s);
+                }
+                return 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+            }
+
+            template <typename Str>
+            static void AppendCodePoint(uint32_t code, Str& s) {
+                if (code < 0x80) {
+                    s.push_back(static_cast<char>(code));
+                }
+                else if (code < 0x800) {
+                    s.push_back(static_cast<char>(0xC0 | (code >> 6)));
+                    s.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+                }
+                else if (code < 0x10000) {
+                    s.push_back(static_cast<char>(0xE0 | (code >> 12)));
+                    s.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                    s.push_back(static_cast<char>(0x80 | (code & 0x3F)));
                 }
                 else {
-                    // Просто считываем очередной символ и помещаем его в результирующую строку
-                    s.push_back(ch);
+                    s.push_back(static_cast<char>(0xF0 | (code >> 18)));
+                    s.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+                    s.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                    s.push_back(static_cast<char>(0x80 | (code & 0x3F)));
                 }
-                ++it;
             }
 
-            return Node(s);
-        }
+            void SkipDigits() {
+                if (AtEnd() || !IsDigit(*pos_)) {
+                    throw ParsingError("A digit is expected"s);
+                }
+                while (!AtEnd() && IsDigit(*pos_)) {
+                    ++pos_;
+                }
+            }
+
+            Number ReadNumber() {
+                mark_ = pos_;
+                const bool is_int = SkipNumber();
+                const Number number = ConvertNumber(mark_, pos_, is_int);
+                mark_ = nullptr;
+                return number;
+            }
 
-        Node LoadBool(istream& input) {
-            CheckInputStream(input);
-            string word;
-            for (int i = 0; i < 4; ++i) {
-                char c;
-                input >> c;
-                word.push_back(c);
+            // Проходит число, проверяя его запись; true, если у него нет дробной части и экспоненты
+            bool SkipNumber() {
+                if (*pos_ == '-') {
+                    ++pos_;
+                }
+                // Парсим целую часть числа, после 0 в JSON не могут идти другие цифры
+                if (!AtEnd() && *pos_ == '0') {
+                    ++pos_;
+                }
+                else {
+                    SkipDigits();
+                }
+
+                bool is_int = true;
+                // Парсим дробную часть числа
+                if (!AtEnd() && *pos_ == '.') {
+                    ++pos_;
+                    SkipDigits();
+                    is_int = false;
+                }
+
+                // Парсим экспоненциальную часть числа
+                if (!AtEnd() && (*pos_ == 'e' || *pos_ == 'E')) {
+                    ++pos_;
+                    if (!AtEnd() && (*pos_ == '+' || *pos_ == '-')) {
+                        ++pos_;
+                    }
+                    SkipDigits();
+                    is_int = false;
+                }
+                return is_int;
             }
-            if (word == "true"s) {
-                return Node(true);
+
+        private:
+            static constexpr size_t BUFFER_SIZE = 1 << 16;
+
+            // Поток, из которого дочитывается buffer_; nullptr, если весь текст уже в памяти
+            std::istream* input_ = nullptr;
+            std::string buffer_;
+        };
+
+        // Не строит дерево, а сообщает обработчику о каждом элементе по мере чтения
+        class EventParser : private Scanner {
+        public:
+            EventParser(std::string_view input, EventHandler& handler)
+                : Scanner(input),
+                handler_(handler)
+            {
+            }
+
+            EventParser(std::istream& input, EventHandler& handler)
+                : Scanner(input),
+                handler_(handler)
+            {
+            }
+
+            void ParseDocument() {
+                ParseNode();
+                ExpectEnd();
             }
-            if (word == "fals"s) {
-                char c;
-                input >> c;
-                if (c == 'e') {
-                    return Node(false);
+
+        private:
+            EventHandler& handler_;
+            // Буфер для ключей и строк переиспользуется, обработчик получает string_view на него
+            string scratch_;
+
+            void ParseNode() {
+                const char c = PeekToken();
+                if (c == '[') {
+                    ParseArray();
+                }
+                else if (c == '{') {
+                    ParseDict();
+                }
+                else if (c == '"') {
+                    scratch_.clear();
+                    ReadString(scratch_);
+                    handler_.String(scratch_);
+                }
+                else if (c == 'n') {
+                    ExpectWord("null"sv);
+                    handler_.Null();
+                }
+                else if (c == 't') {
+                    ExpectWord("true"sv);
+                    handler_.Bool(true);
+                }
+                else if (c == 'f') {
+                    ExpectWord("false"sv);
+                    handler_.Bool(false);
+                }
+                else if (IsDigit(c) || c == '-') {
+                    const Number number = ReadNumber();
+                    if (std::holds_alternative<int>(number)) {
+                        handler_.Int(std::get<int>(number));
+                    }
+                    else {
+                        handler_.Double(std::get<double>(number));
+                    }
+                }
+                else {
+                    throw ParsingError("Invalid first character"s);
                 }
             }
-            throw ParsingError("The uploaded text is not boolean"s);
-        }
 
-        Node LoadArray(istream& input) {
-            CheckInputStream(input);
-            Array result;
+            void ParseArray() {
+                handler_.StartArray();
+                if (!ReadEmptyContainer(']')) {
+                    do {
+                        ParseNode();
+                    } while (!ReadSeparator(']'));
+                }
+                handler_.EndArray();
+            }
 
-            for (char c; input >> c && c != ']';) {
-                if (c != ',') {
-                    input.putback(c);
+            void ParseDict() {
+                handler_.StartDict();
+                if (!ReadEmptyContainer('}')) {
+                    do {
+                        if (PeekToken() != '"') {
+                            throw ParsingError("Expected a key"s);
+                        }
+                        scratch_.clear();
+                        ReadString(scratch_);
+                        handler_.Key(scratch_);
+                        Expect(':');
+                        ParseNode();
+                    } while (!ReadSeparator('}'));
                 }
-                result.push_back(LoadNode(input));
+                handler_.EndDict();
             }
+        };
 
-            return Node(move(result));
+    }  // namespace
+
+    // Строит ленту ленивого документа. Он друг LazyDocument, поэтому объявлен вне безымянного пространства имён
+    class TapeBuilder : private Scanner {
+    public:
+        explicit TapeBuilder(LazyDocument& document)
+            : Scanner(document.text_),
+            document_(document),
+            begin_(document.text_.data())
+        {
         }
 
-        Node LoadDict(istream& input) {
-            CheckInputStream(input);
-            Dict result;
+        void Build() {
+            ParseNode();
+            ExpectEnd();
+        }
 
-            for (char c; input >> c && c != '}';) {
-                if (c == ',') {
-                    input >> c;
-                }
+    private:
+        using TokenKind = LazyDocument::TokenKind;
 
-                string key = LoadString(input).AsString();
-                input >> c;
-                result.insert({ move(key), LoadNode(input) });
-            }
+        LazyDocument& document_;
+        const char* begin_;
 
-            return Node(move(result));
+        size_t Offset(const char* pos) const {
+            return static_cast<size_t>(pos - begin_);
         }
 
-        Node LoadNode(istream& input) {
-            char c;
-            input >> c;
+        void AddToken(TokenKind kind, size_t begin, size_t end) {
+            document_.tape_.push_back({ kind, static_cast<uint32_t>(begin), static_cast<uint32_t>(end) });
+        }
 
+        void ParseNode() {
+            const char c = PeekToken();
             if (c == '[') {
-                return LoadArray(input);
+                ParseArray();
             }
             else if (c == '{') {
-                return LoadDict(input);
+                ParseDict();
             }
             else if (c == '"') {
-                return LoadString(input);
+                ParseString();
             }
             else if (c == 'n') {
-                input.putback(c);
-                return LoadNull(input);
+                ExpectWord("null"sv);
+                AddToken(TokenKind::NULL_VALUE, 0, 0);
             }
-            else if (isdigit(c) || c == '-') {
-                input.putback(c);
-                return LoadNumber(input);
+            else if (c == 't') {
+                ExpectWord("true"sv);
+                AddToken(TokenKind::TRUE_VALUE, 0, 0);
             }
-            else if (c == 't' || c == 'f') {
-                input.putback(c);
-                return LoadBool(input);
+            else if (c == 'f') {
+                ExpectWord("false"sv);
+                AddToken(TokenKind::FALSE_VALUE, 0, 0);
+            }
+            else if (IsDigit(c) || c == '-') {
+                const char* begin = pos_;
+                const bool is_int = SkipNumber();
+                AddToken(is_int ? TokenKind::INTEGER : TokenKind::REAL, Offset(begin), Offset(pos_));
             }
             else {
                 throw ParsingError("Invalid first character"s);
             }
         }
 
-    }  // namespace
+        void ParseString() {
+            const char* body = pos_ + 1;
+            const char* stop = simd::FindStringStop(body, end_);
+            if (stop != end_ && *stop == '"') {
+                AddToken(TokenKind::STRING, Offset(body), Offset(stop));
+                pos_ = stop + 1;
+                return;
+            }
+            // Escape-последовательности и ошибки в строке разбирает общий код, результат копится в decoded_
+            const size_t begin = document_.decoded_.size();
+            ReadString(document_.decoded_);
+            AddToken(TokenKind::DECODED_STRING, begin, document_.decoded_.size());
+        }
+
+        void ParseArray() {
+            const size_t index = document_.tape_.size();
+            AddToken(TokenKind::ARRAY, 0, 0);
+            size_t count = 0;
+            if (!ReadEmptyContainer(']')) {
+                do {
+                    ParseNode();
+                    ++count;
+                } while (!ReadSeparator(']'));
+            }
+            CloseContainer(index, count);
+        }
+
+        void ParseDict() {
+            const size_t index = document_.tape_.size();
+            AddToken(TokenKind::DICT, 0, 0);
+            size_t count = 0;
+            if (!ReadEmptyContainer('}')) {
+                do {
+                    if (PeekToken() != '"') {
+                        throw ParsingError("Expected a key"s);
+                    }
+                    ParseString();
+                    Expect(':');
+                    ParseNode();
+                    ++count;
+                } while (!ReadSeparator('}'));
+            }
+            CloseContainer(index, count);
+        }
+
+        void CloseContainer(size_t index, size_t count) {
+            LazyDocument::Token& token = document_.tape_[index];
+            token.begin = static_cast<uint32_t>(count);
+            token.end = static_cast<uint32_t>(document_.tape_.size());
+        }
+    };
+
+    /*
+     * Значения не разбираются, а только копируются текстом или пропускаются: границы значения
+     * находятся по скобкам вне строк. Синтаксис скопированного текста проверяет ленивый документ
+     */
+    class LazyStreamReader::Impl : private Scanner {
+    public:
+        explicit Impl(std::istream& input)
+            : Scanner(input)
+        {
+        }
+
+        bool NextKey(std::string& key) {
+            if (state_ == State::FINISHED) {
+                return false;
+            }
+            if (state_ == State::NOT_STARTED) {
+                if (PeekToken() != '{') {
+                    throw ParsingError("Expected '{'"s);
+                }
+                if (ReadEmptyContainer('}')) {
+                    return Finish();
+                }
+            }
+            else {
+                SkipRest();
+                if (ReadSeparator('}')) {
+                    return Finish();
+                }
+            }
+            if (PeekToken() != '"') {
+                throw ParsingError("Expected a key"s);
+            }
+            key.clear();
+            ReadString(key);
+            Expect(':');
+            state_ = State::VALUE;
+            return true;
+        }
+
+        LazyDocument ReadValue() {
+            if (state_ != State::VALUE) {
+                throw std::logic_error("The value has already been read"s);
+            }
+            std::string text;
+            PassValue([&text](const char* begin, const char* end) {
+                text.append(begin, end);
+            });
+            state_ = State::CONSUMED;
+            return LazyDocument(move(text));
+        }
+
+        std::optional<LazyDocument> ReadArrayBlock(size_t max_bytes) {
+            if (state_ == State::VALUE) {
+                if (PeekToken() != '[') {
+                    throw ParsingError("Expected '['"s);
+                }
+                if (ReadEmptyContainer(']')) {
+                    state_ = State::CONSUMED;
+                    return std::nullopt;
+                }
+                state_ = State::ARRAY;
+            }
+            if (state_ != State::ARRAY) {
+                return std::nullopt;
+            }
+            std::string text = "[";
+            while (true) {
+                PassValue([&text](const char* begin, const char* end) {
+                    text.append(begin, end);
+                });
+                if (ReadSeparator(']')) {
+                    state_ = State::CONSUMED;
+                    break;
+                }
+                if (text.size() >= max_bytes) {
+                    break;
+                }
+                text.push_back(',');
+            }
+            text.push_back(']');
+            return LazyDocument(move(text));
+        }
+
+    private:
+        enum class State {
+            NOT_STARTED,
+            // Прочитан ключ, его значение ещё не тронуто
+            VALUE,
+            // Значение — массив, часть элементов которого ещё не прочитана
+            ARRAY,
+            CONSUMED,
+            FINISHED
+        };
+
+        State state_ = State::NOT_STARTED;
+
+        bool Finish() {
+            ExpectEnd();
+            state_ = State::FINISHED;
+            return false;
+        }
+
+        // Пропускает то, что осталось от значения текущего ключа
+        void SkipRest() {
+            const auto skip = [](const char*, const char*) {};
+            if (state_ == State::VALUE) {
+                PassValue(skip);
+            }
+            else if (state_ == State::ARRAY) {
+                do {
+                    PassValue(skip);
+                } while (!ReadSeparator(']'));
+            }
+            state_ = State::CONSUMED;
+        }
+
+        // Передаёт текст очередного значения sink участками: перед дочитыванием потока буфер отдаётся целиком
+        template <typename Sink>
+        void PassValue(Sink&& sink) {
+            const char first = PeekToken();
+            const char* run = pos_;
+            if (first != '[' && first != '{' && first != '"') {
+                // Число или литерал заканчивается на разделителе
+                while (true) {
+                    if (pos_ == end_) {
+                        sink(run, pos_);
+                        if (!Refill()) {
+                            return;
+                        }
+                        run = pos_;
+                    }
+                    const char c = *pos_;
+                    if (c == ',' || c == ']' || c == '}' || simd::IsSpace(c)) {
+                        break;
+                    }
+                    ++pos_;
+                }
+                sink(run, pos_);
+                return;
+            }
+            size_t depth = 0;
+            bool is_in_string = false;
+            bool is_escaped = false;
+            while (true) {
+                if (pos_ == end_) {
+                    sink(run, pos_);
+                    if (!Refill()) {
+                        throw ParsingError("Unexpected end of input"s);
+                    }
+                    run = pos_;
+                }
+                if (is_in_string && !is_escaped) {
+                    pos_ = simd::FindStringStop(pos_, end_);
+                    if (pos_ == end_) {
+                        continue;
+                    }
+                }
+                const char c = *pos_++;
+                if (is_escaped) {
+                    is_escaped = false;
+                }
+                else if (is_in_string) {
+                    if (c == '"') {
+                        is_in_string = false;
+                    }
+                    else if (c == '\\') {
+                        is_escaped = true;
+                    }
+                }
+                else if (c == '"') {
+                    is_in_string = true;
+                }
+                else if (c == '[' || c == '{') {
+                    ++depth;
+                }
+                else if (c == ']' || c == '}') {
+                    --depth;
+                }
+                if (depth == 0 && !is_in_string) {
+                    break;
+                }
+            }
+            sink(run, pos_);
+        }
+    };
+
+    Dict::Dict(std::pmr::memory_resource* resource)
+        : items_(resource) {
+    }
+
+    Dict::Dict(std::initializer_list<value_type> items)
+        : Dict(std::pmr::vector<value_type>(items)) {
+    }
+
+    Dict::Dict(std::pmr::vector<value_type> items)
+        : items_(move(items)) {
+        const auto key_less = [](const value_type& lhs, const value_type& rhs) {
+            return lhs.first < rhs.first;
+        };
+        if (items_.size() <= SMALL_SIZE) {
+            // В объектах обычно несколько ключей, и сортировка вставками не требует дополнительной памяти
+            for (size_t i = 1; i < items_.size(); ++i) {
+                for (size_t j = i; j > 0 && key_less(items_[j], items_[j - 1]); --j) {
+                    swap(items_[j], items_[j - 1]);
+                }
+            }
+        }
+        else {
+            stable_sort(items_.begin(), items_.end(), key_less);
+        }
+        items_.erase(unique(items_.begin(), items_.end(), [](const value_type& lhs, const value_type& rhs) {
+            return lhs.first == rhs.first;
+            }), items_.end());
+    }
+
+    std::pmr::vector<Dict::value_type>::iterator Dict::LowerBound(std::string_view key) {
+        return lower_bound(items_.begin(), items_.end(), key, [](const value_type& item, std::string_view key) {
+            return item.first < key;
+            });
+    }
+
+    Dict::const_iterator Dict::LowerBound(std::string_view key) const {
+        return lower_bound(items_.begin(), items_.end(), key, [](const value_type& item, std::string_view key) {
+            return item.first < key;
+            });
+    }
+
+    const Node& Dict::at(std::string_view key) const {
+        const auto it = find(key);
+        if (it == items_.end()) {
+            throw out_of_range("Key "s + string(key) + " is not found"s);
+        }
+        return it->second;
+    }
+
+    size_t Dict::count(std::string_view key) const {
+        return find(key) == items_.end() ? 0 : 1;
+    }
+
+    Dict::const_iterator Dict::find(std::string_view key) const {
+        const auto it = LowerBound(key);
+        if (it == items_.end() || it->first != key) {
+            return items_.end();
+        }
+        return it;
+    }
+
+    pair<Dict::const_iterator, bool> Dict::emplace(std::string_view key, Node value) {
+        auto it = LowerBound(key);
+        if (it != items_.end() && it->first == key) {
+            return { it, false };
+        }
+        it = items_.emplace(it, key, move(value));
+        return { it, true };
+    }
+
+    Node& Dict::operator[](std::string_view key) {
+        auto it = LowerBound(key);
+        if (it == items_.end() || it->first != key) {
+            it = items_.emplace(it, key, Node());
+        }
+        return it->second;
+    }
+
+    Dict::const_iterator Dict::begin() const {
+        return items_.begin();
+    }
+
+    Dict::const_iterator Dict::end() const {
+        return items_.end();
+    }
+
+    size_t Dict::size() const {
+        return items_.size();
+    }
+
+    bool Dict::empty() const {
+        return items_.empty();
+    }
+
+    void Dict::reserve(size_t size) {
+        items_.reserve(size);
+    }
 
     Node::Node(nullptr_t)
         : value_() {
@@ -260,10 +859,18 @@ namespace json {
         : value_(move(value)) {
     }
 
-    Node::Node(string value)
+    Node::Node(String value)
         : value_(move(value)) {
     }
 
+    Node::Node(const string& value)
+        : value_(String(value)) {
+    }
+
+    Node::Node(const char* value)
+        : value_(String(value)) {
+    }
+
     Node::Node(double value)
         : value_(move(value)) {
 
@@ -301,7 +908,7 @@ namespace json {
         return false;
     }
     bool Node::IsString() const {
-        if (holds_alternative<string>(value_)) {
+        if (holds_alternative<String>(value_)) {
             return true;
         }
         return false;
@@ -346,11 +953,11 @@ namespace json {
         return get<int>(value_);
     }
 
-    const string& Node::AsString() const {
+    const String& Node::AsString() const {
         if (!IsString()) {
             throw logic_error("Invalid type");
         }
-        return get<string>(value_);
+        return get<String>(value_);
     }
 
     double Node::AsDouble() const {
@@ -377,130 +984,292 @@ namespace json {
         return value_;
     }
 
-    Document::Document(Node root)
-        : root_(move(root)) {
+    void Parse(std::string_view input, EventHandler& handler) {
+        EventParser(input, handler).ParseDocument();
     }
 
-    const Node& Document::GetRoot() const {
-        return root_;
+    void Parse(istream& input, EventHandler& handler) {
+        EventParser(input, handler).ParseDocument();
     }
 
-    Document Load(istream& input) {
-        return Document{ LoadNode(input) };
+    NodeCollector::NodeCollector(std::pmr::memory_resource* resource)
+        : resource_(resource) {
     }
 
-    void PrintValue(nullptr_t, ostream& out) {
-        out << "null";
+    void NodeCollector::StartDict() {
+        stack_.push_back({ Node(Dict(resource_)), json::String(resource_) });
     }
-    void PrintValue(const Array& as_array, ostream& out) {
-        out << "[";
-        for (auto it = as_array.begin(); it < as_array.end(); ++it) {
-            if (it + 1 == as_array.end()) {
-                PrintNode(*it, out);
-                break;
-            }
-            PrintNode(*it, out);
-            out << ",";
+
+    void NodeCollector::Key(std::string_view key) {
+        stack_.back().key.assign(key.data(), key.size());
+    }
+
+    void NodeCollector::EndDict() {
+        EndContainer();
+    }
+
+    void NodeCollector::StartArray() {
+        stack_.push_back({ Node(Array(resource_)), json::String(resource_) });
+    }
+
+    void NodeCollector::EndArray() {
+        EndContainer();
+    }
+
+    void NodeCollector::Null() {
+        AddNode(Node(nullptr));
+    }
+
+    void NodeCollector::Bool(bool value) {
+        AddNode(Node(value));
+    }
+
+    void NodeCollector::Int(int value) {
+        AddNode(Node(value));
+    }
+
+    void NodeCollector::Double(double value) {
+        AddNode(Node(value));
+    }
+
+    void NodeCollector::String(std::string_view value) {
+        AddNode(Node(json::String(value, resource_)));
+    }
+
+    bool NodeCollector::IsComplete() const {
+        return is_complete_;
+    }
+
+    Node NodeCollector::Extract() {
+        is_complete_ = false;
+        return move(root_);
+    }
+
+    void NodeCollector::EndContainer() {
+        Node node = move(stack_.back().container);
+        stack_.pop_back();
+        AddNode(move(node));
+    }
+
+    void NodeCollector::AddNode(Node node) {
+        if (stack_.empty()) {
+            root_ = move(node);
+            is_complete_ = true;
+            return;
+        }
+        Node::Value& container = stack_.back().container.GetNonConstValue();
+        if (holds_alternative<Dict>(container)) {
+            get<Dict>(container).emplace(stack_.back().key, move(node));
         }
-        out << "]";
+        else {
+            get<Array>(container).push_back(move(node));
+        }
+    }
+
+    LazyNode::LazyNode(const LazyDocument& document, size_t index)
+        : document_(&document),
+        index_(index) {
+    }
+
+    bool LazyNode::IsInt() const {
+        const LazyDocument::Token& token = document_->GetToken(index_);
+        return token.kind == LazyDocument::TokenKind::INTEGER && holds_alternative<int>(document_->GetNumber(token));
+    }
+    bool LazyNode::IsDouble() const {
+        const LazyDocument::TokenKind kind = document_->GetToken(index_).kind;
+        return kind == LazyDocument::TokenKind::INTEGER || kind == LazyDocument::TokenKind::REAL;
+    }
+    bool LazyNode::IsPureDouble() const {
+        return IsDouble() && !IsInt();
+    }
+    bool LazyNode::IsBool() const {
+        const LazyDocument::TokenKind kind = document_->GetToken(index_).kind;
+        return kind == LazyDocument::TokenKind::TRUE_VALUE || kind == LazyDocument::TokenKind::FALSE_VALUE;
+    }
+    bool LazyNode::IsString() const {
+        const LazyDocument::TokenKind kind = document_->GetToken(index_).kind;
+        return kind == LazyDocument::TokenKind::STRING || kind == LazyDocument::TokenKind::DECODED_STRING;
+    }
+    bool LazyNode::IsNull() const {
+        return document_->GetToken(index_).kind == LazyDocument::TokenKind::NULL_VALUE;
+    }
+    bool LazyNode::IsArray() const {
+        return document_->GetToken(index_).kind == LazyDocument::TokenKind::ARRAY;
+    }
+    bool LazyNode::IsMap() const {
+        return document_->GetToken(index_).kind == LazyDocument::TokenKind::DICT;
     }
-    void PrintValue(const Dict& as_map, ostream& out) {
-        out << "{";
-        int size = as_map.size();
-        for (const auto [key, value] : as_map) {
-            if (size == 1) {
-                out << "\"" << key << "\"" << ":";
-                PrintNode(value, out);
-                break;
+
+    int LazyNode::AsInt() const {
+        const LazyDocument::Token& token = document_->GetToken(index_);
+        if (token.kind == LazyDocument::TokenKind::INTEGER) {
+            const Number number = document_->GetNumber(token);
+            if (holds_alternative<int>(number)) {
+                return get<int>(number);
             }
-            out << "\"" << key << "\"" << ":";
-            PrintNode(value, out);
-            out << ",";
-            --size;
         }
-        out << "}";
+        throw logic_error("Invalid type");
     }
-    void PrintValue(bool as_bool, ostream& out) {
-        if (as_bool) {
-            out << "true"s;
-            return;
+
+    double LazyNode::AsDouble() const {
+        if (!IsDouble()) {
+            throw logic_error("Invalid type");
         }
-        out << "false"s;
+        const Number number = document_->GetNumber(document_->GetToken(index_));
+        return holds_alternative<int>(number) ? get<int>(number) * 1.0 : get<double>(number);
     }
-    void PrintValue(int as_int, ostream& out) {
-        out << as_int;
+
+    bool LazyNode::AsBool() const {
+        if (!IsBool()) {
+            throw logic_error("Invalid type");
+        }
+        return document_->GetToken(index_).kind == LazyDocument::TokenKind::TRUE_VALUE;
     }
-    void PrintValue(double as_double, ostream& out) {
-        out << as_double;
+
+    std::string_view LazyNode::AsString() const {
+        if (!IsString()) {
+            throw logic_error("Invalid type");
+        }
+        return document_->GetString(document_->GetToken(index_));
     }
-    void PrintValue(string as_string, ostream& out) {
-        string result = as_string;
-        int pos = 0;
-        while (pos < static_cast<int>(result.size())) {
-            if (result.find('\\', pos) != ::std::string::npos) {
-                pos = result.find('\\', pos);
-                result.replace(pos, 1, "\\\\");
-                pos += 3;
-            }
-            else {
-                break;
-            }
+
+    LazyArray LazyNode::AsArray() const {
+        if (!IsArray()) {
+            throw logic_error("Invalid type");
         }
-        pos = 0;
-        while (pos < static_cast<int>(result.size())) {
-            if (result.find('\"', pos) != ::std::string::npos) {
-                pos = result.find('\"', pos);
-                result.replace(pos, 1, "\\\"");
-                pos += 2;
-            }
-            else {
-                break;
-            }
+        return LazyArray(*document_, index_);
+    }
+
+    LazyMap LazyNode::AsMap() const {
+        if (!IsMap()) {
+            throw logic_error("Invalid type");
         }
-        pos = 0;
-        while (pos < static_cast<int>(result.size())) {
-            if (result.find('\n', pos) != ::std::string::npos) {
-                pos = result.find('\n', pos);
-                result.replace(pos, 1, "\\n");
-                pos += 2;
-            }
-            else {
-                break;
-            }
+        return LazyMap(*document_, index_);
+    }
+
+    LazyArray::Iterator::Iterator(const LazyDocument& document, size_t index)
+        : document_(&document),
+        index_(index) {
+    }
+
+    LazyNode LazyArray::Iterator::operator*() const {
+        return LazyNode(*document_, index_);
+    }
+
+    LazyArray::Iterator& LazyArray::Iterator::operator++() {
+        index_ = document_->Skip(index_);
+        return *this;
+    }
+
+    bool LazyArray::Iterator::operator!=(const Iterator& other) const {
+        return index_ != other.index_;
+    }
+
+    LazyArray::LazyArray(const LazyDocument& document, size_t index)
+        : document_(&document),
+        index_(index) {
+    }
+
+    size_t LazyArray::size() const {
+        return document_->GetToken(index_).begin;
+    }
+
+    LazyArray::Iterator LazyArray::begin() const {
+        return Iterator(*document_, index_ + 1);
+    }
+
+    LazyArray::Iterator LazyArray::end() const {
+        return Iterator(*document_, document_->GetToken(index_).end);
+    }
+
+    LazyMap::LazyMap(const LazyDocument& document, size_t index)
+        : document_(&document),
+        index_(index) {
+    }
+
+    size_t LazyMap::size() const {
+        return document_->GetToken(index_).begin;
+    }
+
+    LazyNode LazyMap::at(std::string_view key) const {
+        const size_t index = Find(key);
+        if (index == 0) {
+            throw out_of_range("Key "s + string(key) + " is not found"s);
         }
-        pos = 0;
-        while (pos < static_cast<int>(result.size())) {
-            if (result.find('\t', pos) != ::std::string::npos) {
-                pos = result.find('\t', pos);
-                result.replace(pos, 1, "\t");
-                pos += 2;
-            }
-            else {
-                break;
+        return LazyNode(*document_, index);
+    }
+
+    size_t LazyMap::count(std::string_view key) const {
+        return Find(key) == 0 ? 0 : 1;
+    }
+
+    size_t LazyMap::Find(std::string_view key) const {
+        // Ключей в запросах единицы, поэтому их просто перебираем по ленте, перескакивая через значения
+        const size_t end = document_->GetToken(index_).end;
+        size_t index = index_ + 1;
+        while (index != end) {
+            if (document_->GetString(document_->GetToken(index)) == key) {
+                return index + 1;
             }
+            index = document_->Skip(index + 1);
         }
-        pos = 0;
-        while (pos < static_cast<int>(result.size())) {
-            if (result.find('\r', pos) != ::std::string::npos) {
-                pos = result.find('\r', pos);
-                result.replace(pos, 1, "\\r");
-                pos += 2;
-            }
-            else {
-                break;
-            }
+        return 0;
+    }
+
+    LazyDocument::LazyDocument(std::string text)
+        : text_(move(text)) {
+        if (text_.size() > numeric_limits<uint32_t>::max()) {
+            throw ParsingError("Document is too large for lazy loading"s);
         }
-        out << "\"" << result << "\"";
+        TapeBuilder(*this).Build();
+    }
+
+    LazyNode LazyDocument::GetRoot() const {
+        return LazyNode(*this, 0);
+    }
+
+    const LazyDocument::Token& LazyDocument::GetToken(size_t index) const {
+        return tape_[index];
+    }
+
+    std::string_view LazyDocument::GetString(const Token& token) const {
+        const std::string& source = token.kind == TokenKind::DECODED_STRING ? decoded_ : text_;
+        return std::string_view(source).substr(token.begin, token.end - token.begin);
     }
 
-    void PrintNode(const Node& node, std::ostream& out) {
-        std::visit(
-            [&out](const auto& value) { PrintValue(value, out); },
-            node.GetValue());
+    std::variant<int, double> LazyDocument::GetNumber(const Token& token) const {
+        return ConvertNumber(text_.data() + token.begin, text_.data() + token.end, token.kind == TokenKind::INTEGER);
     }
 
-    void Print(const Document& doc, std::ostream& output) {
-        PrintNode(doc.GetRoot(), output);
+    size_t LazyDocument::Skip(size_t index) const {
+        const Token& token = tape_[index];
+        return token.kind == TokenKind::ARRAY || token.kind == TokenKind::DICT ? token.end : index + 1;
+    }
+
+    LazyStreamReader::LazyStreamReader(std::istream& input)
+        : impl_(std::make_unique<Impl>(input)) {
+    }
+
+    LazyStreamReader::~LazyStreamReader() = default;
+
+    bool LazyStreamReader::NextKey(std::string& key) {
+        return impl_->NextKey(key);
+    }
+
+    LazyDocument LazyStreamReader::ReadValue() {
+        return impl_->ReadValue();
+    }
+
+    std::optional<LazyDocument> LazyStreamReader::ReadArrayBlock(size_t max_bytes) {
+        return impl_->ReadArrayBlock(max_bytes);
+    }
+
+    bool operator==(const Dict& l, const Dict& r) noexcept {
+        return l.size() == r.size() && equal(l.begin(), l.end(), r.begin());
+    }
+
+    bool operator!=(const Dict& l, const Dict& r) noexcept {
+        return !(l == r);
     }
 
     bool operator==(const Node& l, const Node& r) noexcept {
@@ -513,7 +1282,7 @@ namespace json {
         if (holds_alternative<double>(l.GetValue()) && holds_alternative<double>(r.GetValue())) {
             return l.AsDouble() == r.AsDouble();
         }
-        if (holds_alternative<string>(l.GetValue()) && holds_alternative<string>(r.GetValue())) {
+        if (holds_alternative<String>(l.GetValue()) && holds_alternative<String>(r.GetValue())) {
             return l.AsString() == r.AsString();
         }
         if (holds_alternative<Array>(l.GetValue()) && holds_alternative<Array>(r.GetValue())) {
@@ -532,12 +1301,4 @@ namespace json {
         return !(l == r);
     }
 
-    bool operator==(const Document& l, const Document& r) noexcept {
-        return l.GetRoot() == r.GetRoot();
-    }
-
-    bool operator!=(const Document& l, const Document& r) noexcept {
-        return !(l.GetRoot() == r.GetRoot());
-    }
-
 }  // namespace json
@@ -1,16 +1,60 @@
 #pragma once
 
+#include <cstdint>
+#include <initializer_list>
 #include <iostream>
-#include <map>
+#include <memory>
+#include <memory_resource>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <variant>
 
 namespace json {
 
     class Node;
-    using Dict = std::map<std::string, Node>;
-    using Array = std::vector<Node>;
+    // Строки и контейнеры узлов берут память из memory_resource: по умолчанию из кучи, а узлы,
+    // собранные NodeCollector в арену, — из неё, так что всё дерево освобождается вместе с ареной
+    using String = std::pmr::string;
+    using Array = std::pmr::vector<Node>;
+
+    /*
+     * Словарь JSON: пары ключ-значение лежат плоским вектором, отсортированным по ключу.
+     * В отличие от std::map, на каждый ключ не выделяется отдельный узел дерева,
+     * а объекты из нескольких ключей занимают одно непрерывное выделение памяти.
+     * Интерфейс повторяет используемую часть std::map: at, count, find, emplace, operator[]
+     */
+    class Dict {
+    public:
+        using value_type = std::pair<String, Node>;
+        using const_iterator = std::pmr::vector<value_type>::const_iterator;
+        using iterator = const_iterator;
+
+        Dict() = default;
+        explicit Dict(std::pmr::memory_resource* resource);
+        Dict(std::initializer_list<value_type> items);
+        // Сортирует пары; при повторе ключа остаётся первое значение, как при вставке в std::map
+        explicit Dict(std::pmr::vector<value_type> items);
+
+        const Node& at(std::string_view key) const;
+        size_t count(std::string_view key) const;
+        const_iterator find(std::string_view key) const;
+        std::pair<const_iterator, bool> emplace(std::string_view key, Node value);
+        Node& operator[](std::string_view key);
+
+        const_iterator begin() const;
+        const_iterator end() const;
+        size_t size() const;
+        bool empty() const;
+        void reserve(size_t size);
+
+    private:
+        static constexpr size_t SMALL_SIZE = 16;
+        std::pmr::vector<value_type> items_;
+        std::pmr::vector<value_type>::iterator LowerBound(std::string_view key);
+        const_iterator LowerBound(std::string_view key) const;
+    };
 
     class ParsingError : public std::runtime_error {
     public:
@@ -19,12 +63,14 @@ namespace json {
 
     class Node {
     public:
-        using Value = std::variant<std::nullptr_t, Array, Dict, bool, int, double, std::string>;
+        using Value = std::variant<std::nullptr_t, Array, Dict, bool, int, double, String>;
         explicit Node() = default;
         Node(int value);
         Node(double value);
         Node(bool value);
-        Node(std::string value);
+        Node(String value);
+        Node(const std::string& value);
+        Node(const char* value);
         Node(std::nullptr_t);
         Node(Array array);
         Node(Dict map);
@@ -36,7 +82,7 @@ namespace json {
         bool IsBool() const;
         bool AsBool() const;
         bool IsString() const;
-        const std::string& AsString() const;
+        const String& AsString() const;
         bool IsNull() const;
         bool IsArray() const;
         const Array& AsArray() const;
@@ -48,31 +94,210 @@ namespace json {
         Value value_;
     };
 
-    class Document {
+    /*
+     * Получатель событий потокового разбора. Дерево Node не строится:
+     * каждый ключ и значение передаются обработчику в порядке следования в тексте.
+     * Строки в Key и String действительны только до возврата из вызова
+     */
+    class EventHandler {
     public:
-        explicit Document(Node root);
+        virtual ~EventHandler() = default;
+        virtual void StartDict() = 0;
+        virtual void Key(std::string_view key) = 0;
+        virtual void EndDict() = 0;
+        virtual void StartArray() = 0;
+        virtual void EndArray() = 0;
+        virtual void Null() = 0;
+        virtual void Bool(bool value) = 0;
+        virtual void Int(int value) = 0;
+        virtual void Double(double value) = 0;
+        virtual void String(std::string_view value) = 0;
+    };
 
-        const Node& GetRoot() const;
+    void Parse(std::string_view input, EventHandler& handler);
+    // Читает поток блоками: события идут по мере чтения, память не зависит от размера входа
+    void Parse(std::istream& input, EventHandler& handler);
 
+    /*
+     * Собирает Node из событий. Удобен, когда потоком читается весь документ, а деревом нужна лишь его часть.
+     * Память узлов берётся из resource; собранный узел не должен пережить его
+     */
+    class NodeCollector : public EventHandler {
+    public:
+        explicit NodeCollector(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+        void StartDict() override;
+        void Key(std::string_view key) override;
+        void EndDict() override;
+        void StartArray() override;
+        void EndArray() override;
+        void Null() override;
+        void Bool(bool value) override;
+        void Int(int value) override;
+        void Double(double value) override;
+        void String(std::string_view value) override;
+        // Значение верхнего уровня полностью собрано
+        bool IsComplete() const;
+        Node Extract();
     private:
+        struct Level {
+            Node container;
+            json::String key;
+        };
+        std::pmr::memory_resource* resource_;
+        std::vector<Level> stack_;
         Node root_;
+        bool is_complete_ = false;
+        void EndContainer();
+        void AddNode(Node node);
+    };
+
+    /*
+     * Ленивый документ. Разбор только строит ленту токенов со смещениями в тексте и проверяет синтаксис.
+     * Числа преобразуются при обращении к ним, строки без escape-последовательностей отдаются видом
+     * на исходный текст; редкие строки с escape-последовательностями раскодируются сразу при разборе.
+     * Узлы, массивы и словари — лёгкие дескрипторы позиции на ленте, действительные, пока жив документ
+     */
+    class LazyDocument;
+    class LazyArray;
+    class LazyMap;
+
+    class LazyNode {
+    public:
+        LazyNode(const LazyDocument& document, size_t index);
+
+        bool IsInt() const;
+        bool IsDouble() const;
+        bool IsPureDouble() const;
+        bool IsBool() const;
+        bool IsString() const;
+        bool IsNull() const;
+        bool IsArray() const;
+        bool IsMap() const;
+
+        int AsInt() const;
+        double AsDouble() const;
+        bool AsBool() const;
+        std::string_view AsString() const;
+        LazyArray AsArray() const;
+        LazyMap AsMap() const;
+
+    private:
+        const LazyDocument* document_;
+        size_t index_;
+    };
+
+    class LazyArray {
+    public:
+        class Iterator {
+        public:
+            Iterator(const LazyDocument& document, size_t index);
+            LazyNode operator*() const;
+            Iterator& operator++();
+            bool operator!=(const Iterator& other) const;
+        private:
+            const LazyDocument* document_;
+            size_t index_;
+        };
+
+        LazyArray(const LazyDocument& document, size_t index);
+        size_t size() const;
+        Iterator begin() const;
+        Iterator end() const;
+
+    private:
+        const LazyDocument* document_;
+        size_t index_;
     };
 
-    Document Load(std::istream& input);
+    class LazyMap {
+    public:
+        LazyMap(const LazyDocument& document, size_t index);
+        size_t size() const;
+        // Как и у Dict: при повторе ключа действует первое значение
+        LazyNode at(std::string_view key) const;
+        size_t count(std::string_view key) const;
+
+    private:
+        const LazyDocument* document_;
+        size_t index_;
+        // Номер токена значения или 0, если ключа нет
+        size_t Find(std::string_view key) const;
+    };
+
+    class LazyDocument {
+    public:
+        // Разбирает text, который документ хранит у себя
+        explicit LazyDocument(std::string text);
 
-    void PrintValue(std::nullptr_t, std::ostream& out);
-    void PrintValue(const Array& as_array, std::ostream& out);
-    void PrintValue(const Dict& as_map, std::ostream& out);
-    void PrintValue(bool as_bool, std::ostream& out);
-    void PrintValue(int as_int, std::ostream& out);
-    void PrintValue(double as_double, std::ostream& out);
-    void PrintValue(std::string as_string, std::ostream& out);
-    void PrintNode(const Node& node, std::ostream& out);
-    void Print(const Document& doc, std::ostream& output);
+        LazyNode GetRoot() const;
+
+    private:
+        friend class LazyNode;
+        friend class LazyArray;
+        friend class LazyMap;
+        friend class TapeBuilder;
+
+        enum class TokenKind : uint8_t {
+            NULL_VALUE,
+            TRUE_VALUE,
+            FALSE_VALUE,
+            INTEGER,
+            REAL,
+            STRING,
+            DECODED_STRING,
+            ARRAY,
+            DICT
+        };
+
+        /*
+         * У чисел и строк begin и end — границы в тексте (у DECODED_STRING — в decoded_).
+         * У контейнеров begin — число элементов, end — номер токена сразу за контейнером.
+         * Ключ словаря — токен строки перед токеном значения. 32-битные поля вдвое сокращают ленту,
+         * поэтому текст ленивого документа ограничен 4 ГБ
+         */
+        struct Token {
+            TokenKind kind;
+            uint32_t begin;
+            uint32_t end;
+        };
+
+        std::string text_;
+        std::string decoded_;
+        std::vector<Token> tape_;
+
+        const Token& GetToken(size_t index) const;
+        std::string_view GetString(const Token& token) const;
+        std::variant<int, double> GetNumber(const Token& token) const;
+        // Номер токена, следующего за значением index вместе со всем его содержимым
+        size_t Skip(size_t index) const;
+    };
+
+    /*
+     * Читает документ-словарь из потока по ключам верхнего уровня через ограниченный буфер.
+     * Значение ключа можно получить ленивым документом целиком, а большой массив — блоками
+     * элементов, каждый своим документом-массивом. Непрочитанные значения пропускаются без копирования
+     */
+    class LazyStreamReader {
+    public:
+        explicit LazyStreamReader(std::istream& input);
+        ~LazyStreamReader();
+
+        // Читает следующий ключ; false, если словарь закончился и после него во входе ничего нет
+        bool NextKey(std::string& key);
+        // Значение текущего ключа целиком
+        LazyDocument ReadValue();
+        // Следующие элементы массива — значения текущего ключа: пока их текст не достигнет max_bytes,
+        // но не меньше одного. Пустой optional, когда массив закончился
+        std::optional<LazyDocument> ReadArrayBlock(size_t max_bytes);
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> impl_;
+    };
 
+    bool operator==(const Dict& l, const Dict& r) noexcept;
+    bool operator!=(const Dict& l, const Dict& r) noexcept;
     bool operator==(const Node& l, const Node& r) noexcept;
     bool operator!=(const Node& l, const Node& r) noexcept;
-    bool operator==(const Document& l, const Document& r) noexcept;
-    bool operator!=(const Document& l, const Document& r) noexcept;
 
 }  // namespace json
@@ -1,7 +1,25 @@
 #include "json_reader.h"
+#include "metrics.h"
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <type_traits>
 
+namespace {
+
+	// Время разбора входного JSON, вместе с чтением потока
+	metrics::Histogram& GetJsonLoadHistogram() {
+		static metrics::Histogram& histogram = metrics::GetHistogram("json.load");
+		return histogram;
+	}
+
+	// Сколько байт текста stat_requests process_requests читает перед тем, как ответить на прочитанное
+	constexpr size_t STAT_BLOCK_SIZE = 1 << 20;
+
+} // namespace
 
 JsonReader::JsonReader()
 	: catalogue_(transport_catalogue::TransportCatalogue()),
@@ -10,64 +28,218 @@ JsonReader::JsonReader()
 {
 }
 
-std::string JsonReader::Print(const json::Node& node) {
-	std::ostringstream out;
-	json::Print(json::Document{ node }, out);
-	return out.str();
+// Расстояния и маршруты ссылаются на остановки, которые могут встретиться позже, поэтому добавляются последними
+void JsonReader::AddDeferredBaseRequests(std::vector<StopDistancesInput>& stop_distances_inputs, std::vector<BusInput>& bus_inputs) {
+	for (auto& stop : stop_distances_inputs) {
+		handler.AddStopDistancesToCatalogue(stop.name, stop.stop_to_distance);
+	}
+	for (auto& bus : bus_inputs) {
+		handler.AddBusToCatalogue(bus.name, bus.route, bus.is_rounded);
+	}
 }
 
-JsonReader::BusInput JsonReader::ParseBusInput(const json::Node& node) {
-	BusInput result;
-	result.name = node.AsMap().at("name").AsString();
-	result.is_rounded = node.AsMap().at("is_roundtrip").AsBool();
-	for (const auto& stop_name : node.AsMap().at("stops").AsArray()) {
-		result.route.push_back(stop_name.AsString());
+/*
+ * Потоковый разбор входа make_base. Элементы base_requests разбираются по мере чтения:
+ * остановки сразу попадают в каталог, а для расстояний и маршрутов копятся только их поля.
+ * Остальные разделы невелики и собираются в Node, чтобы разобрать их как раньше. Узлы разделов
+ * берут память из арены обработчика и освобождаются вместе с ней, без обхода дерева
+ */
+class JsonReader::InputHandler : public json::EventHandler {
+public:
+	explicit InputHandler(JsonReader& reader)
+		: reader_(reader),
+		collector_(&sections_arena_)
+	{
 	}
-	return result;
-}
-JsonReader::StopInput JsonReader::ParseStopInput(const json::Node& node) {
-	StopInput result;
-	result.name = node.AsMap().at("name").AsString();
-	result.latitude = node.AsMap().at("latitude").AsDouble();
-	result.longitude = node.AsMap().at("longitude").AsDouble();
-	return result;
-}
-JsonReader::StopDistancesInput JsonReader::ParseStopWithDistanceInput(const json::Node& node) {
-	StopDistancesInput result;
-	result.name = node.AsMap().at("name").AsString();
-	for (const auto& [key, value] : node.AsMap().at("road_distances").AsMap()) {
-		result.stop_to_distance.push_back({ key, value.AsInt() });
+
+	void StartDict() override {
+		if (IsCollecting()) {
+			collector_.StartDict();
+		}
+		else if (depth_ == BASE_ENTRY_DEPTH - 1) {
+			entry_ = Entry();
+		}
+		++depth_;
+	}
+
+	void Key(std::string_view key) override {
+		if (depth_ == ROOT_DEPTH) {
+			section_.assign(key.data(), key.size());
+		}
+		else if (IsCollecting()) {
+			collector_.Key(key);
+		}
+		else if (depth_ == BASE_ENTRY_DEPTH) {
+			field_.assign(key.data(), key.size());
+		}
+		else if (depth_ == BASE_ENTRY_DEPTH + 1 && field_ == "road_distances") {
+			entry_.road_distances.push_back({ std::string(key), 0 });
+		}
+	}
+
+	void EndDict() override {
+		--depth_;
+		if (IsCollecting()) {
+			collector_.EndDict();
+			TakeSection();
+		}
+		else if (depth_ == BASE_ENTRY_DEPTH - 1) {
+			AddEntry();
+		}
+	}
+
+	void StartArray() override {
+		if (IsCollecting()) {
+			collector_.StartArray();
+		}
+		++depth_;
+	}
+
+	void EndArray() override {
+		--depth_;
+		if (IsCollecting()) {
+			collector_.EndArray();
+			TakeSection();
+		}
+	}
+
+	void Null() override {
+		OnValue(nullptr);
+	}
+	void Bool(bool value) override {
+		OnValue(value);
+	}
+	void Int(int value) override {
+		OnValue(value);
+	}
+	void Double(double value) override {
+		OnValue(value);
+	}
+	void String(std::string_view value) override {
+		OnValue(value);
+	}
+
+	// Разделы, кроме base_requests, в виде готовых узлов
+	std::map<std::string, json::Node>& GetSections() {
+		return sections_;
+	}
+
+	void Finish() {
+		reader_.AddDeferredBaseRequests(stop_distances_inputs_, bus_inputs_);
+	}
+
+private:
+	// Глубина вложенности внутри корневого словаря и внутри элемента base_requests
+	static constexpr int ROOT_DEPTH = 1;
+	static constexpr int BASE_ENTRY_DEPTH = 3;
+
+	struct Entry {
+		std::string type;
+		std::string name;
+		double latitude = 0;
+		double longitude = 0;
+		bool is_roundtrip = false;
+		std::vector<std::pair<std::string, int>> road_distances;
+		std::vector<std::string> stops;
+	};
+
+	JsonReader& reader_;
+	int depth_ = 0;
+	std::string section_;
+	std::string field_;
+	Entry entry_;
+	// Объявлена раньше узлов, которые в ней лежат, поэтому разрушается после них
+	std::pmr::monotonic_buffer_resource sections_arena_;
+	json::NodeCollector collector_;
+	std::map<std::string, json::Node> sections_;
+	std::vector<StopDistancesInput> stop_distances_inputs_;
+	std::vector<BusInput> bus_inputs_;
+
+	bool IsCollecting() const {
+		return depth_ >= ROOT_DEPTH && section_ != "base_requests";
 	}
-	return result;
-}
 
-void JsonReader::ParseBaseRequests(const json::Node& array) {
-	std::vector<BusInput> bus_inputs;
-	std::vector<StopDistancesInput> stop_distances_inputs;
-	for (const json::Node& node : array.AsArray()) {
-		if (node.AsMap().at("type").AsString() == "Bus") {
-			bus_inputs.push_back(ParseBusInput(node));
+	void TakeSection() {
+		if (depth_ == ROOT_DEPTH) {
+			// Как в json::Dict и в LazyMap: при повторе раздела действует первый, собранный узел повтора отбрасывается
+			sections_.try_emplace(section_, collector_.Extract());
 		}
-		if (node.AsMap().at("type").AsString() == "Stop") {
-			if (node.AsMap().count("road_distances") != 0) {
-				StopInput stop_input = ParseStopInput(node);
-				handler.AddStopToCatalogue(stop_input.name, stop_input.latitude, stop_input.longitude);
-				stop_distances_inputs.push_back(ParseStopWithDistanceInput(node));
+	}
+
+	template <typename Value>
+	void OnValue(Value value) {
+		if (IsCollecting()) {
+			if constexpr (std::is_same_v<Value, std::nullptr_t>) {
+				collector_.Null();
+			}
+			else if constexpr (std::is_same_v<Value, bool>) {
+				collector_.Bool(value);
+			}
+			else if constexpr (std::is_same_v<Value, int>) {
+				collector_.Int(value);
+			}
+			else if constexpr (std::is_same_v<Value, double>) {
+				collector_.Double(value);
 			}
 			else {
-				StopInput stop_input = ParseStopInput(node);
-				handler.AddStopToCatalogue(stop_input.name, stop_input.latitude, stop_input.longitude);
-
+				collector_.String(value);
+			}
+			TakeSection();
+		}
+		else if (depth_ == BASE_ENTRY_DEPTH) {
+			SetField(value);
+		}
+		else if (depth_ == BASE_ENTRY_DEPTH + 1) {
+			if constexpr (std::is_same_v<Value, int>) {
+				if (field_ == "road_distances" && !entry_.road_distances.empty()) {
+					entry_.road_distances.back().second = value;
+				}
+			}
+			else if constexpr (std::is_same_v<Value, std::string_view>) {
+				if (field_ == "stops") {
+					entry_.stops.emplace_back(value);
+				}
 			}
 		}
 	}
-	for (auto& stop : stop_distances_inputs) {
-		handler.AddStopDistancesToCatalogue(stop.name, stop.stop_to_distance);
+
+	template <typename Value>
+	void SetField(Value value) {
+		if constexpr (std::is_same_v<Value, std::string_view>) {
+			if (field_ == "type") {
+				entry_.type = value;
+			}
+			else if (field_ == "name") {
+				entry_.name = value;
+			}
+		}
+		else if constexpr (std::is_same_v<Value, int> || std::is_same_v<Value, double>) {
+			if (field_ == "latitude") {
+				entry_.latitude = value;
+			}
+			else if (field_ == "longitude") {
+				entry_.longitude = value;
+			}
+		}
+		else if constexpr (std::is_same_v<Value, bool>) {
+			if (field_ == "is_roundtrip") {
+				entry_.is_roundtrip = value;
+			}
+		}
 	}
-	for (auto& bus : bus_inputs) {
-		handler.AddBusToCatalogue(bus.name, bus.route, bus.is_rounded);
+
+	void AddEntry() {
+		if (entry_.type == "Stop") {
+			reader_.handler.AddStopToCatalogue(entry_.name, entry_.latitude, entry_.longitude);
+			if (!entry_.road_distances.empty()) {
+				stop_distances_inputs_.push_back({ std::move(entry_.name), std::move(entry_.road_distances) });
+			}
+		}
+		else if (entry_.type == "Bus") {
+			bus_inputs_.push_back({ std::move(entry_.name), std::move(entry_.stops), entry_.is_roundtrip });
+		}
 	}
-}
+};
 
 void JsonReader::ParseRenderSettings(const json::Node& node) {
 	handler.SetWidthToRenderer(node.AsMap().at("width").AsDouble());
@@ -88,64 +260,119 @@ void JsonReader::ParseRenderSettings(const json::Node& node) {
 	handler.SetColorPaletteToRenderer(color_palette);
 }
 
-std::pair<std::string, transport_catalogue::TransportCatalogue> JsonReader::ParseInput(std::istream& input) {
-	json::Document queries(json::Load(input));
+void JsonReader::ParseRoutingSettings(const json::Node& node) {
+	handler.SetBusVelocity(node.AsMap().at("bus_velocity").AsDouble());
+	handler.SetBusWaitTime(node.AsMap().at("bus_wait_time").AsInt());
+	if (node.AsMap().count("pedestrian_velocity") != 0) {
+		handler.SetPedestrianVelocity(node.AsMap().at("pedestrian_velocity").AsDouble());
+	}
+}
+
+std::string JsonReader::ParseInput(std::istream& input) {
+	// Дерево всего документа не строится: base_requests сразу превращаются в вызовы каталога
+	InputHandler input_handler(*this);
+	{
+		const metrics::ScopedTimer timer(GetJsonLoadHistogram());
+		json::Parse(input, input_handler);
+	}
+	input_handler.Finish();
 	std::string file_name = "";
-	for (const auto& [key, value] : queries.GetRoot().AsMap()) {
-		if (key == "base_requests") {
-			ParseBaseRequests(value);
-		}
-		else if (key == "render_settings") {
+	for (const auto& [key, value] : input_handler.GetSections()) {
+		if (key == "render_settings") {
 			ParseRenderSettings(value);
 		}
 		else if (key == "routing_settings") {
-			handler.SetBusVelocity(value.AsMap().at("bus_velocity").AsDouble());
-			handler.SetBusWaitTime(value.AsMap().at("bus_wait_time").AsInt());
+			ParseRoutingSettings(value);
 		}
 		else if (key == "serialization_settings") {
 			file_name = value.AsMap().at("file").AsString();
 		}
 	}
-	return std::make_pair(file_name, catalogue_);
+	// После make_base набор имён не меняется, поэтому индекс имён строится один раз и сохраняется в базе
+	catalogue_.Freeze();
+	return file_name;
 }
 
-std::pair<std::string, std::stringstream> JsonReader::ParseStatInput(std::istream& input) {
-	json::Document queries(json::Load(input));
-	std::string file_name = "";
-	std::stringstream ss;
-	for (const auto& [key, value] : queries.GetRoot().AsMap()) {
-		if (key == "stat_requests") {
-			json::Print(queries, ss);
+const transport_catalogue::TransportCatalogue& JsonReader::GetCatalogue() const {
+	return catalogue_;
+}
+
+void JsonReader::SetCatalogue(transport_catalogue::TransportCatalogue&& catalogue) {
+	// Обработчик хранит ссылку на catalogue_, поэтому достаточно переместить данные в него
+	catalogue_ = std::move(catalogue);
+}
+
+/*
+ * Вход process_requests читается потоком через ограниченный буфер. Запросы stat_requests берутся
+ * блоками по STAT_BLOCK_SIZE байт текста, каждый блок — свой ленивый документ: из запроса раскодируются
+ * только поля, которые прочтёт обработчик, и ответы блока выводятся до чтения следующего.
+ * Поэтому первый ответ выходит, не дожидаясь конца входа, а память не растёт с числом запросов.
+ * Если serialization_settings идёт после stat_requests, база к ним ещё неизвестна:
+ * тогда запросы читаются целиком и отвечаются одним пакетом в конце
+ */
+request_handler::BatchStats JsonReader::CalculateOutput(std::istream& input, const std::function<void(const std::string&)>& load_base, size_t threads) {
+	json::LazyStreamReader reader(input);
+	const auto timed = [](const auto& read) {
+		const metrics::ScopedTimer timer(GetJsonLoadHistogram());
+		return read();
+	};
+	// Как и в словаре, при повторе ключа действует первое значение
+	std::optional<std::string> file_name;
+	bool has_requests = false;
+	bool is_loaded = false;
+	std::optional<json::LazyDocument> deferred_requests;
+	request_handler::BatchStats stats;
+	std::string key;
+	while (timed([&]() { return reader.NextKey(key); })) {
+		if (key == "serialization_settings" && !file_name) {
+			const json::LazyDocument settings = timed([&]() { return reader.ReadValue(); });
+			file_name = std::string(settings.GetRoot().AsMap().at("file").AsString());
 		}
-		else if (key == "serialization_settings") {
-			file_name = value.AsMap().at("file").AsString();
+		else if (key == "stat_requests" && !has_requests) {
+			has_requests = true;
+			if (!file_name) {
+				deferred_requests = timed([&]() { return reader.ReadValue(); });
+				continue;
+			}
+			load_base(*file_name);
+			is_loaded = true;
+			request_handler::RequestHandler::BatchStream batch(handler, std::cout, threads);
+			while (const std::optional<json::LazyDocument> block = timed([&]() { return reader.ReadArrayBlock(STAT_BLOCK_SIZE); })) {
+				batch.Answer(block->GetRoot().AsArray());
+			}
+			stats = batch.Finish();
+			std::cout << std::endl;
 		}
 	}
-	return std::make_pair(file_name, std::move(ss));
+	if (!is_loaded) {
+		load_base(file_name.value_or(""));
+	}
+	if (deferred_requests) {
+		stats = handler.ParseStatRequests(deferred_requests->GetRoot().AsArray(), std::cout, threads);
+		std::cout << std::endl;
+	}
+	return stats;
 }
 
-std::string JsonReader::ParseFilename(std::istream& input) {
-	json::Document queries(json::Load(input));
-	for (const auto& [key, value] : queries.GetRoot().AsMap()) {
-		if (key == "serialization_settings") {
-			return value.AsMap().at("file").AsString();
-		}
+request_handler::BatchStats JsonReader::AnswerBatch(std::string batch, std::ostream& output, size_t threads) {
+	const json::LazyDocument document = [&batch]() {
+		const metrics::ScopedTimer timer(GetJsonLoadHistogram());
+		return json::LazyDocument(std::move(batch));
+	}();
+	const json::LazyMap root = document.GetRoot().AsMap();
+	if (root.count("stat_requests") == 0) {
+		output << "[]";
+		return {};
 	}
-	return "";
+	return handler.ParseStatRequests(root.at("stat_requests").AsArray(), output, threads);
 }
 
-void JsonReader::SetCatalogue(transport_catalogue::TransportCatalogue& catalogue) {
-	catalogue_ = catalogue;
-	handler.SetCatalogue(catalogue_);
+void JsonReader::PrepareRouter() {
+	handler.PrepareRouter();
 }
 
-void JsonReader::CalculateOutput(std::istream& input) {
-	json::Document queries(json::Load(input));
-	for (const auto& [key, value] : queries.GetRoot().AsMap()) {
-		if (key == "stat_requests") {
-			std::cout << Print(handler.ParseStatRequests(value)) << std::endl;
-		}
-	}
+request_handler::RequestHandler& JsonReader::GetHandler() {
+	return handler;
 }
 
 const renderer::MapRenderer::MapSettings JsonReader::GetMapSettings() const {
@@ -159,7 +386,7 @@ void JsonReader::SetRenderer(renderer::MapRenderer map_renderer) {
 
 svg::Color JsonReader::GetColorFromNode(const json::Node& node) {
 	if (node.IsString()) {
-		return svg::Color(node.AsString());
+		return svg::Color(std::string(node.AsString()));
 	}
 	else if (node.IsArray()) {
 		if (node.AsArray().size() == 4) {
@@ -172,11 +399,16 @@ svg::Color JsonReader::GetColorFromNode(const json::Node& node) {
 	return svg::Color();
 }
 
-std::pair<int, double> JsonReader::GetBusRouterInfo() const {
-	return std::make_pair(handler.GetBusWaitTime(), handler.GetBusVelocity());
+transport_router::RoutingSettings JsonReader::GetRoutingSettings() const {
+	transport_router::RoutingSettings routing_settings;
+	routing_settings.bus_wait_time = handler.GetBusWaitTime();
+	routing_settings.bus_velocity = handler.GetBusVelocity();
+	routing_settings.pedestrian_velocity = handler.GetPedestrianVelocity();
+	return routing_settings;
 }
 
-void JsonReader::SetBusRouterInfo(std::pair<int, double>& router_info) {
-	handler.SetBusWaitTime(router_info.first);
-	handler.SetBusVelocity(router_info.second);
+void JsonReader::SetRoutingSettings(const transport_router::RoutingSettings& routing_settings) {
+	handler.SetBusWaitTime(routing_settings.bus_wait_time);
+	handler.SetBusVelocity(routing_settings.bus_velocity);
+	handler.SetPedestrianVelocity(routing_settings.pedestrian_velocity);
 }
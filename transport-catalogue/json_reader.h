@@ -1,4 +1,5 @@
 #pragma once
+#include <functional>
 #include <iostream>
 #include <string>
 #include "json.h"
@@ -8,12 +9,6 @@
 
 class JsonReader {
 public:
-    struct StopInput {
-        std::string name;
-        double latitude;
-        double longitude;
-    };
-
     struct StopDistancesInput {
         std::string name;
         std::vector<std::pair<std::string, int>> stop_to_distance;
@@ -26,24 +21,29 @@ public:
     };
 
     JsonReader();
-    std::string Print(const json::Node& node);
-    std::pair<std::string, transport_catalogue::TransportCatalogue> ParseInput(std::istream& input);
-    std::string ParseFilename(std::istream& input);
-    BusInput ParseBusInput(const json::Node& node);
-    StopInput ParseStopInput(const json::Node& node);
-    StopDistancesInput ParseStopWithDistanceInput(const json::Node& array);
-    void ParseBaseRequests(const json::Node& array);
+    std::string ParseInput(std::istream& input);
     void ParseRenderSettings(const json::Node& node);
-    void SetCatalogue(transport_catalogue::TransportCatalogue& catalogue);
-    std::pair<std::string, std::stringstream> ParseStatInput(std::istream& input);
-    void CalculateOutput(std::istream& input);
+    const transport_catalogue::TransportCatalogue& GetCatalogue() const;
+    void SetCatalogue(transport_catalogue::TransportCatalogue&& catalogue);
+    // Читает вход process_requests за один проход и отвечает на запросы блоками по мере чтения;
+    // load_base вызывается с именем файла базы до первого ответа.
+    // threads — число потоков, в которых обрабатываются запросы
+    request_handler::BatchStats CalculateOutput(std::istream& input, const std::function<void(const std::string&)>& load_base, size_t threads = 1);
+    // Отвечает на один пакет, когда база уже загружена: batch — документ JSON со stat_requests,
+    // в output выводится массив ответов. Прочие разделы документа не читаются
+    request_handler::BatchStats AnswerBatch(std::string batch, std::ostream& output, size_t threads = 1);
+    void PrepareRouter();
+    request_handler::RequestHandler& GetHandler();
     const renderer::MapRenderer::MapSettings GetMapSettings() const;
     void SetRenderer(renderer::MapRenderer map_renderer);
-    std::pair<int, double> GetBusRouterInfo() const;
-    void SetBusRouterInfo(std::pair<int, double>& router_info);
+    transport_router::RoutingSettings GetRoutingSettings() const;
+    void SetRoutingSettings(const transport_router::RoutingSettings& routing_settings);
 private:
+    class InputHandler;
     transport_catalogue::TransportCatalogue catalogue_;
     renderer::MapRenderer map_renderer_;
     request_handler::RequestHandler handler;
     svg::Color GetColorFromNode(const json::Node& node);
+    void ParseRoutingSettings(const json::Node& node);
+    void AddDeferredBaseRequests(std::vector<StopDistancesInput>& stop_distances_inputs, std::vector<BusInput>& bus_inputs);
 };
@@ -0,0 +1,175 @@
+#include "json_simd.h"
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define JSON_SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace json {
+
+    namespace simd {
+
+        namespace {
+
+            const char* FindStringStopScalar(const char* pos, const char* end) {
+                while (pos != end && !IsStringStop(*pos)) {
+                    ++pos;
+                }
+                return pos;
+            }
+
+            const char* SkipSpacesScalar(const char* pos, const char* end) {
+                while (pos != end && IsSpace(*pos)) {
+                    ++pos;
+                }
+                return pos;
+            }
+
+#ifdef JSON_SIMD_X86
+
+            inline unsigned CountTrailingZeros(uint32_t mask) {
+#if defined(_MSC_VER)
+                unsigned long index;
+                _BitScanForward(&index, mask);
+                return index;
+#else
+                return __builtin_ctz(mask);
+#endif
+            }
+
+            bool HasAvx2() {
+#if defined(_MSC_VER)
+                int info[4];
+                __cpuid(info, 0);
+                if (info[0] < 7) {
+                    return false;
+                }
+                __cpuid(info, 1);
+                // Процессор умеет AVX, а ОС сохраняет его регистры при переключении задач
+                const bool has_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+                __cpuidex(info, 7, 0);
+                return has_avx && (info[1] & (1 << 5));
+#else
+                return __builtin_cpu_supports("avx2");
+#endif
+            }
+
+            const bool HAS_AVX2 = HasAvx2();
+
+            const char* FindStringStopSse2(const char* pos, const char* end) {
+                const __m128i quote = _mm_set1_epi8('"');
+                const __m128i backslash = _mm_set1_epi8('\\');
+                const __m128i line_feed = _mm_set1_epi8('\n');
+                const __m128i carriage_return = _mm_set1_epi8('\r');
+                while (end - pos >= 16) {
+                    const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+                    const __m128i stops = _mm_or_si128(
+                        _mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash)),
+                        _mm_or_si128(_mm_cmpeq_epi8(block, line_feed), _mm_cmpeq_epi8(block, carriage_return)));
+                    const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(stops));
+                    if (mask != 0) {
+                        return pos + CountTrailingZeros(mask);
+                    }
+                    pos += 16;
+                }
+                return FindStringStopScalar(pos, end);
+            }
+
+            const char* SkipSpacesSse2(const char* pos, const char* end) {
+                const __m128i space = _mm_set1_epi8(' ');
+                const __m128i line_feed = _mm_set1_epi8('\n');
+                const __m128i carriage_return = _mm_set1_epi8('\r');
+                const __m128i tab = _mm_set1_epi8('\t');
+                while (end - pos >= 16) {
+                    const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+                    const __m128i spaces = _mm_or_si128(
+                        _mm_or_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(block, line_feed)),
+                        _mm_or_si128(_mm_cmpeq_epi8(block, carriage_return), _mm_cmpeq_epi8(block, tab)));
+                    const uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(spaces)) & 0xFFFFu;
+                    if (mask != 0) {
+                        return pos + CountTrailingZeros(mask);
+                    }
+                    pos += 16;
+                }
+                return SkipSpacesScalar(pos, end);
+            }
+
+#if defined(__GNUC__)
+#define JSON_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define JSON_TARGET_AVX2
+#endif
+
+            JSON_TARGET_AVX2 const char* FindStringStopAvx2(const char* pos, const char* end) {
+                const __m256i quote = _mm256_set1_epi8('"');
+                const __m256i backslash = _mm256_set1_epi8('\\');
+                const __m256i line_feed = _mm256_set1_epi8('\n');
+                const __m256i carriage_return = _mm256_set1_epi8('\r');
+                while (end - pos >= 32) {
+                    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos));
+                    const __m256i stops = _mm256_or_si256(
+                        _mm256_or_si256(_mm256_cmpeq_epi8(block, quote), _mm256_cmpeq_epi8(block, backslash)),
+                        _mm256_or_si256(_mm256_cmpeq_epi8(block, line_feed), _mm256_cmpeq_epi8(block, carriage_return)));
+                    const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(stops));
+                    if (mask != 0) {
+                        return pos + CountTrailingZeros(mask);
+                    }
+                    pos += 32;
+                }
+                return FindStringStopSse2(pos, end);
+            }
+
+            JSON_TARGET_AVX2 const char* SkipSpacesAvx2(const char* pos, const char* end) {
+                const __m256i space = _mm256_set1_epi8(' ');
+                const __m256i line_feed = _mm256_set1_epi8('\n');
+                const __m256i carriage_return = _mm256_set1_epi8('\r');
+                const __m256i tab = _mm256_set1_epi8('\t');
+                while (end - pos >= 32) {
+                    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos));
+                    const __m256i spaces = _mm256_or_si256(
+                        _mm256_or_si256(_mm256_cmpeq_epi8(block, space), _mm256_cmpeq_epi8(block, line_feed)),
+                        _mm256_or_si256(_mm256_cmpeq_epi8(block, carriage_return), _mm256_cmpeq_epi8(block, tab)));
+                    const uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(spaces));
+                    if (mask != 0) {
+                        return pos + CountTrailingZeros(mask);
+                    }
+                    pos += 32;
+                }
+                return SkipSpacesSse2(pos, end);
+            }
+
+#undef JSON_TARGET_AVX2
+
+#endif
+
+        }  // namespace
+
+#ifdef JSON_SIMD_X86
+
+        const char* FindStringStop(const char* pos, const char* end) {
+            return HAS_AVX2 ? FindStringStopAvx2(pos, end) : FindStringStopSse2(pos, end);
+        }
+
+        const char* SkipSpaces(const char* pos, const char* end) {
+            return HAS_AVX2 ? SkipSpacesAvx2(pos, end) : SkipSpacesSse2(pos, end);
+        }
+
+#else
+
+        const char* FindStringStop(const char* pos, const char* end) {
+            return FindStringStopScalar(pos, end);
+        }
+
+        const char* SkipSpaces(const char* pos, const char* end) {
+            return SkipSpacesScalar(pos, end);
+        }
+
+#endif
+
+    } // namespace simd
+
+} // namespace json
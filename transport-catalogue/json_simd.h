@@ -0,0 +1,62 @@
+#pragma once
+#include <string_view>
+
+namespace json {
+
+    /*
+     * Векторный поиск по блокам: тело строки пропускается до первой кавычки, обратной косой черты
+     * или перевода строки, пробельные символы — до первого значимого. SSE2 есть на любом x86-64,
+     * AVX2 выбирается во время выполнения, если его поддерживает процессор. Хвост короче блока
+     * и другие архитектуры обрабатываются побайтно
+     */
+    namespace simd {
+
+        inline bool IsStringStop(char c) {
+            return c == '"' || c == '\\' || c == '\n' || c == '\r';
+        }
+
+        inline bool IsSpace(char c) {
+            return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+        }
+
+        // Первый символ из IsStringStop или end
+        const char* FindStringStop(const char* pos, const char* end);
+        // Первый непробельный символ или end
+        const char* SkipSpaces(const char* pos, const char* end);
+
+        /*
+         * Экранирует текст строки JSON, передавая его sink частями: участки без особых символов
+         * целиком, как есть, а кавычки, обратную косую черту и переводы строк — escape-последовательностями
+         */
+        template <typename Sink>
+        void Escape(std::string_view value, Sink&& sink) {
+            const char* pos = value.data();
+            const char* end = pos + value.size();
+            while (pos != end) {
+                const char* stop = FindStringStop(pos, end);
+                if (stop != pos) {
+                    sink(std::string_view(pos, static_cast<size_t>(stop - pos)));
+                }
+                if (stop == end) {
+                    break;
+                }
+                switch (*stop) {
+                case '"':
+                    sink(std::string_view("\\\"", 2));
+                    break;
+                case '\\':
+                    sink(std::string_view("\\\\", 2));
+                    break;
+                case '\n':
+                    sink(std::string_view("\\n", 2));
+                    break;
+                default:
+                    sink(std::string_view("\\r", 2));
+                }
+                pos = stop + 1;
+            }
+        }
+
+    } // namespace simd
+
+} // namespace json
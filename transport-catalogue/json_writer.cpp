@@ -0,0 +1,218 @@
+#include "json_writer.h"
+#include "json_simd.h"
+#include <charconv>
+#include <streambuf>
+
+using namespace std;
+
+namespace json {
+
+    namespace {
+
+        // Буфер потока, который экранирует записанное и дописывает результат в строку.
+        // Запись копится в небольшом блоке и экранируется им целиком
+        class EscapingBuffer : public std::streambuf {
+        public:
+            explicit EscapingBuffer(string& output)
+                : output_(output) {
+                setp(chunk_, chunk_ + sizeof(chunk_));
+            }
+
+        protected:
+            int_type overflow(int_type c) override {
+                FlushChunk();
+                if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                    *pptr() = traits_type::to_char_type(c);
+                    pbump(1);
+                }
+                return traits_type::not_eof(c);
+            }
+
+            streamsize xsputn(const char* s, streamsize count) override {
+                if (count <= epptr() - pptr()) {
+                    traits_type::copy(pptr(), s, static_cast<size_t>(count));
+                    pbump(static_cast<int>(count));
+                }
+                else {
+                    // Крупный кусок экранируется сразу, минуя блок
+                    FlushChunk();
+                    Append(std::string_view(s, static_cast<size_t>(count)));
+                }
+                return count;
+            }
+
+            int sync() override {
+                FlushChunk();
+                return 0;
+            }
+
+        private:
+            string& output_;
+            char chunk_[4096];
+
+            void Append(std::string_view text) {
+                simd::Escape(text, [this](std::string_view part) {
+                    output_.append(part);
+                });
+            }
+
+            void FlushChunk() {
+                Append(std::string_view(pbase(), static_cast<size_t>(pptr() - pbase())));
+                setp(chunk_, chunk_ + sizeof(chunk_));
+            }
+        };
+
+    }  // namespace
+
+    void Writer::BeforeValue() {
+        if (need_separator_) {
+            buffer_.push_back(',');
+        }
+    }
+
+    Writer& Writer::StartDict() {
+        BeforeValue();
+        buffer_.push_back('{');
+        need_separator_ = false;
+        return *this;
+    }
+
+    Writer& Writer::EndDict() {
+        buffer_.push_back('}');
+        need_separator_ = true;
+        return *this;
+    }
+
+    Writer& Writer::StartArray() {
+        BeforeValue();
+        buffer_.push_back('[');
+        need_separator_ = false;
+        return *this;
+    }
+
+    Writer& Writer::EndArray() {
+        buffer_.push_back(']');
+        need_separator_ = true;
+        return *this;
+    }
+
+    Writer& Writer::Key(std::string_view key) {
+        String(key);
+        buffer_.push_back(':');
+        // Значение идёт сразу за ключом, без запятой
+        need_separator_ = false;
+        return *this;
+    }
+
+    Writer& Writer::Null() {
+        BeforeValue();
+        buffer_.append("null"sv);
+        need_separator_ = true;
+        return *this;
+    }
+
+    Writer& Writer::Bool(bool value) {
+        BeforeValue();
+        buffer_.append(value ? "true"sv : "false"sv);
+        need_separator_ = true;
+        return *this;
+    }
+
+    Writer& Writer::Int(int value) {
+        BeforeValue();
+        char chars[16];
+        const auto result = to_chars(chars, chars + sizeof(chars), value);
+        buffer_.append(chars, result.ptr);
+        need_separator_ = true;
+        return *this;
+    }
+
+    Writer& Writer::Double(double value) {
+        BeforeValue();
+        // Шесть значащих цифр, как при выводе double в поток с настройками по умолчанию
+        char chars[32];
+        const auto result = to_chars(chars, chars + sizeof(chars), value, chars_format::general, 6);
+        buffer_.append(chars, result.ptr);
+        need_separator_ = true;
+        return *this;
+    }
+
+    Writer& Writer::String(std::string_view value) {
+        BeforeValue();
+        buffer_.push_back('"');
+        simd::Escape(value, [this](std::string_view chunk) {
+            buffer_.append(chunk);
+        });
+        buffer_.push_back('"');
+        need_separator_ = true;
+        return *this;
+    }
+
+    Writer& Writer::String(const std::function<void(std::ostream&)>& write) {
+        BeforeValue();
+        buffer_.push_back('"');
+        EscapingBuffer escaping(buffer_);
+        std::ostream output(&escaping);
+        write(output);
+        output.flush();
+        buffer_.push_back('"');
+        need_separator_ = true;
+        return *this;
+    }
+
+    Writer& Writer::Value(const Node& node) {
+        if (node.IsNull()) {
+            return Null();
+        }
+        else if (node.IsBool()) {
+            return Bool(node.AsBool());
+        }
+        else if (node.IsInt()) {
+            return Int(node.AsInt());
+        }
+        else if (node.IsPureDouble()) {
+            return Double(node.AsDouble());
+        }
+        else if (node.IsString()) {
+            return String(node.AsString());
+        }
+        else if (node.IsArray()) {
+            StartArray();
+            for (const Node& item : node.AsArray()) {
+                Value(item);
+            }
+            return EndArray();
+        }
+        StartDict();
+        for (const auto& [key, value] : node.AsMap()) {
+            Key(key);
+            Value(value);
+        }
+        return EndDict();
+    }
+
+    Writer& Writer::Raw(std::string_view json) {
+        if (json.empty()) {
+            return *this;
+        }
+        BeforeValue();
+        buffer_.append(json);
+        need_separator_ = true;
+        return *this;
+    }
+
+    std::string_view Writer::GetBuffer() const {
+        return buffer_;
+    }
+
+    void Writer::Flush(std::ostream& output) {
+        output.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        buffer_.clear();
+    }
+
+    void Writer::Clear() {
+        buffer_.clear();
+        need_separator_ = false;
+    }
+
+} // namespace json
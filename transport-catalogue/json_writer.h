@@ -0,0 +1,43 @@
+#pragma once
+#include "json.h"
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+namespace json {
+
+    /*
+     * Пишет JSON сразу в текстовый буфер, без промежуточного дерева Node.
+     * Запятые между элементами расставляются автоматически. Буфер переиспользуется:
+     * Flush выводит накопленный текст и очищает его, сохраняя выделенную память
+     */
+    class Writer {
+    public:
+        Writer& StartDict();
+        Writer& EndDict();
+        Writer& StartArray();
+        Writer& EndArray();
+        Writer& Key(std::string_view key);
+        Writer& Null();
+        Writer& Bool(bool value);
+        Writer& Int(int value);
+        Writer& Double(double value);
+        Writer& String(std::string_view value);
+        // Строка, текст которой write выводит в поток: он экранируется на лету, без промежуточной копии
+        Writer& String(const std::function<void(std::ostream&)>& write);
+        // Вывод готового узла, когда ответ уже собран деревом
+        Writer& Value(const Node& node);
+        // Вставляет готовый текст JSON (одно или несколько значений через запятую) как очередной элемент
+        Writer& Raw(std::string_view json);
+        std::string_view GetBuffer() const;
+        void Flush(std::ostream& output);
+        // Начинает запись заново, как у нового объекта, сохраняя выделенную память
+        void Clear();
+    private:
+        std::string buffer_;
+        bool need_separator_ = false;
+        void BeforeValue();
+    };
+
+} // namespace json
@@ -1,32 +1,165 @@
+#include <algorithm>
+#include <charconv>
 #include <fstream>
 #include <iostream>
+#include <optional>
+#include <string>
 #include <string_view>
+#include "metrics.h"
 #include "serialization.h"
+#include "server.h"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
 
 using namespace std::literals;
 
 void PrintUsage(std::ostream& stream = std::cerr) {
-    stream << "Usage: transport_catalogue [make_base|process_requests]\n"sv;
+    stream << "Usage: transport_catalogue [make_base|process_requests [--threads=N] [--stats] [--format=json|proto]|serve BASE_FILE [--threads=N] [--socket=PATH]] [--metrics[=FILE]]\n"sv;
+}
+
+// Убирает из аргументов --metrics[=FILE] и включает по нему сбор метрик. Сводка выводится
+// при завершении процесса в FILE или в stderr. Возвращает новое число аргументов
+int TakeMetricsOption(int argc, char* argv[]) {
+    const std::string_view prefix = "--metrics="sv;
+    std::optional<std::string> path;
+    int kept = 1;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg(argv[i]);
+        if (arg == "--metrics"sv) {
+            path = std::string();
+        }
+        else if (arg.substr(0, prefix.size()) == prefix && arg.size() > prefix.size()) {
+            path = std::string(arg.substr(prefix.size()));
+        }
+        else {
+            argv[kept++] = argv[i];
+        }
+    }
+    if (path) {
+        metrics::DumpAtExit(std::move(*path));
+    }
+    return kept;
+}
+
+// Больше потоков не ускоряет ответы, а только расходует память на их стеки и буферы
+constexpr unsigned long MAX_THREADS = 256;
+
+// Разбирает --threads=N, где N от 1; значения больше MAX_THREADS урезаются до него
+bool ParseThreads(std::string_view arg, size_t& threads) {
+    const std::string_view prefix = "--threads="sv;
+    if (arg.substr(0, prefix.size()) != prefix) {
+        return false;
+    }
+    const std::string_view digits = arg.substr(prefix.size());
+    const char* end = digits.data() + digits.size();
+    unsigned long value = 0;
+    const auto [ptr, ec] = std::from_chars(digits.data(), end, value);
+    if (ec == std::errc::result_out_of_range && ptr == end) {
+        value = MAX_THREADS;
+    }
+    else if (ec != std::errc() || ptr != end || value == 0) {
+        return false;
+    }
+    threads = static_cast<size_t>(std::min(value, MAX_THREADS));
+    return true;
+}
+
+// Доля запросов, ответ на которые взят у такого же запроса пакета
+void PrintStats(const request_handler::BatchStats& stats, std::ostream& stream = std::cerr) {
+    const double ratio = stats.request_count != 0 ? 100.0 * stats.duplicate_count / stats.request_count : 0.0;
+    stream << "stat requests: "sv << stats.request_count
+        << ", answered from duplicates: "sv << stats.duplicate_count
+        << " ("sv << ratio << "%)\n"sv;
+}
+
+// Двоичный поток нельзя читать и писать в текстовом режиме: Windows заменяет в нём переводы строк
+void SetBinaryStdio() {
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
+    argc = TakeMetricsOption(argc, argv);
+    if (argc < 2) {
         PrintUsage();
         return 1;
     }
     const std::string_view mode(argv[1]);
     Serialization serialization;
 
-    if (mode == "make_base"sv) {
+    if (mode == "make_base"sv && argc == 2) {
         serialization.MakeBase(std::cin);
         // make base here
 
     }
     else if (mode == "process_requests"sv) {
-        serialization.ProcessRequests(std::cin);
-        // process requests here
+        size_t threads = 1;
+        bool print_stats = false;
+        bool is_proto = false;
+        for (int i = 2; i < argc; ++i) {
+            const std::string_view arg(argv[i]);
+            if (arg == "--stats"sv) {
+                print_stats = true;
+            }
+            else if (arg == "--format=proto"sv) {
+                is_proto = true;
+                SetBinaryStdio();
+            }
+            else if (arg != "--format=json"sv && !ParseThreads(arg, threads)) {
+                PrintUsage();
+                return 1;
+            }
+        }
+        try {
+            // Двоичный поток отвечается в одном потоке по мере чтения, --threads к нему не применяется
+            const request_handler::BatchStats stats = is_proto
+                ? serialization.ProcessProtoRequests(std::cin, std::cout)
+                : serialization.ProcessRequests(std::cin, threads);
+            // process requests here
+            if (print_stats) {
+                PrintStats(stats);
+            }
+        }
+        catch (const std::exception& error) {
+            std::cerr << error.what() << '\n';
+            return 1;
+        }
 
     }
+    else if (mode == "serve"sv && argc >= 3) {
+        const std::string base_file_name(argv[2]);
+        size_t threads = 1;
+        std::string socket_path;
+        for (int i = 3; i < argc; ++i) {
+            const std::string_view arg(argv[i]);
+            const std::string_view socket_prefix = "--socket="sv;
+            if (arg.substr(0, socket_prefix.size()) == socket_prefix && arg.size() > socket_prefix.size()) {
+                socket_path = std::string(arg.substr(socket_prefix.size()));
+            }
+            else if (!ParseThreads(arg, threads)) {
+                PrintUsage();
+                return 1;
+            }
+        }
+        try {
+            server::Server server(base_file_name, threads);
+            if (socket_path.empty()) {
+                server.ServeStream(std::cin, std::cout);
+            }
+            else {
+                server.ServeSocket(socket_path);
+            }
+        }
+        catch (const std::exception& error) {
+            std::cerr << error.what() << '\n';
+            return 1;
+        }
+    }
     else {
         PrintUsage();
         return 1;
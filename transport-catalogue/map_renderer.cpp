@@ -8,12 +8,17 @@ namespace renderer {
         return std::abs(value) < EPSILON;
     }
 
-    svg::Polyline MapRenderer::MakeRoutePolilyne(std::vector<geo::Coordinates>& current_points, int color_index) const {
+    svg::Polyline MapRenderer::MakeRoutePolilyne(const domain::Bus& bus, int color_index) const {
         svg::Polyline result;
-        for (const auto& coordinate : current_points) {
-            result.AddPoint(proj(coordinate));
+        for (const domain::Stop* stop : bus.route) {
+            result.AddPoint(proj(stop->coordinates));
         }
-        return result.SetFillColor(svg::Color())
+        if (!bus.is_rounded && !bus.route.empty()) {
+            for (auto it = std::next(bus.route.rbegin()); it != bus.route.rend(); ++it) {
+                result.AddPoint(proj((*it)->coordinates));
+            }
+        }
+        return result.SetFillColor(svg::NoneColor)
             .SetStrokeWidth(settings_.line_width)
             .SetStrokeLineCap(svg::StrokeLineCap::ROUND)
             .SetStrokeLineJoin(svg::StrokeLineJoin::ROUND)
@@ -134,10 +139,10 @@ namespace renderer {
         settings_.color_palette.push_back(name);
     }
     void MapRenderer::AddColorToPalette(const svg::Rgb& rgb) {
-        settings_.color_palette.push_back(rgb);
+        settings_.color_palette.emplace_back(std::in_place_type<svg::Rgb>, rgb);
     }
     void MapRenderer::AddColorToPalette(const svg::Rgba& rgba) {
-        settings_.color_palette.push_back(rgba);
+        settings_.color_palette.emplace_back(std::in_place_type<svg::Rgba>, rgba);
     }
     void MapRenderer::AddColorToPalette(const svg::Color& color) {
         settings_.color_palette.push_back(color);
@@ -1,4 +1,5 @@
 #pragma once
+#include "domain.h"
 #include "geo.h"
 #include "svg.h"
 
@@ -110,7 +111,7 @@ namespace renderer {
         };
         template <typename Request_Handler>
         void RenderMap(Request_Handler& handler, svg::Document& doc);
-        svg::Polyline MakeRoutePolilyne(std::vector<geo::Coordinates>& current_points, int color_index) const;
+        svg::Polyline MakeRoutePolilyne(const domain::Bus& bus, int color_index) const;
         svg::Text MakeBusUnderlayer(geo::Coordinates coordinates, std::string_view bus_name) const;
         svg::Text MakeBusName(geo::Coordinates coordinates, int color_index, std::string_view bus_name) const;
         svg::Circle MakeStop(geo::Coordinates coordinates) const;
@@ -151,79 +152,37 @@ namespace renderer {
 
     template <typename Request_Handler>
     void MapRenderer::RenderMap(Request_Handler& handler, svg::Document& doc) {
-        int color_index = 0;
-        int color_capacity = GetColorCapacity();
-        std::vector<BusRender> all_buses;
-        std::set<std::string_view> all_stops;
+        const int color_capacity = GetColorCapacity();
+        auto next_color = [color_capacity](int color_index) {
+            return color_index + 1 == color_capacity ? 0 : color_index + 1;
+        };
         SetShpereProjector(handler.GetAllStopCoordinates());
-        for (const std::string_view& bus_name : handler.GetAllBusesNames()) { //Проход по всем маршрутам и их отрисовка + заполнение массивов всех маршрутов и остановок для дальнейшей отрисовки
-            BusRender new_bus;
-            new_bus.name = bus_name;
-            new_bus.color_index = color_index;
-            std::vector<geo::Coordinates> current_stops_coordinates;
-            auto stat = handler.GetBusStat(bus_name);
-            if (stat.has_value()) {
-                if (stat.value().is_rounded) {
-                    new_bus.is_rounded = true;
-                    for (const auto& stop_name : handler.GetBusRoute(bus_name)) {
-                        new_bus.route.push_back(stop_name);
-                        all_stops.insert(stop_name);
-                        current_stops_coordinates.push_back(handler.GetStopCoordinates(stop_name));
-                    }
-                }
-                else {
-                    new_bus.is_rounded = false;
-                    auto bus_stops = handler.GetBusRoute(bus_name);
-                    for (const auto& stop_name : bus_stops) {
-                        new_bus.route.push_back(stop_name);
-                        all_stops.insert(stop_name);
-                        current_stops_coordinates.push_back(handler.GetStopCoordinates(stop_name));
-                    }
-                    std::reverse(bus_stops.begin(), bus_stops.end());
-                    bool is_first = true;
-                    for (const auto& stop_name : bus_stops) {
-                        if (is_first) {
-                            is_first = false;
-                            continue;
-                        }
-                        current_stops_coordinates.push_back(handler.GetStopCoordinates(stop_name));
-                    }
-                }
-            }
-
-            doc.Add(MakeRoutePolilyne(current_stops_coordinates, color_index));
-            if (color_index + 1 == color_capacity) {
-                color_index = 0;
-            }
-            else {
-                ++color_index;
-            }
-            all_buses.push_back(new_bus);
+        // Маршруты и остановки уже отсортированы по названию в каталоге, поэтому обходим их без копирования
+        int color_index = 0;
+        for (const domain::Bus* bus : handler.GetSortedBuses()) { // Отрисовка линий маршрутов
+            doc.Add(MakeRoutePolilyne(*bus, color_index));
+            color_index = next_color(color_index);
         }
-        for (const BusRender& bus : all_buses) { // Отрисовка названий маршрутов
-            if (bus.is_rounded) {
-                doc.Add(MakeBusUnderlayer(handler.GetStopCoordinates(*bus.route.begin()), bus.name));
-                doc.Add(MakeBusName(handler.GetStopCoordinates(*bus.route.begin()), bus.color_index, bus.name));
-            }
-            else {
-                if (*(bus.route.begin()) == *(bus.route.end() - 1)) {
-                    doc.Add(MakeBusUnderlayer(handler.GetStopCoordinates(*bus.route.begin()), bus.name));
-                    doc.Add(MakeBusName(handler.GetStopCoordinates(*bus.route.begin()), bus.color_index, bus.name));
-                }
-                else {
-                    doc.Add(MakeBusUnderlayer(handler.GetStopCoordinates(*bus.route.begin()), bus.name));
-                    doc.Add(MakeBusName(handler.GetStopCoordinates(*bus.route.begin()), bus.color_index, bus.name));
-                    doc.Add(MakeBusUnderlayer(handler.GetStopCoordinates(*(bus.route.end() - 1)), bus.name));
-                    doc.Add(MakeBusName(handler.GetStopCoordinates(*(bus.route.end() - 1)), bus.color_index, bus.name));
+        color_index = 0;
+        for (const domain::Bus* bus : handler.GetSortedBuses()) { // Отрисовка названий маршрутов
+            if (!bus->route.empty()) {
+                const domain::Stop* first_stop = bus->route.front();
+                const domain::Stop* last_stop = bus->route.back();
+                doc.Add(MakeBusUnderlayer(first_stop->coordinates, bus->name));
+                doc.Add(MakeBusName(first_stop->coordinates, color_index, bus->name));
+                if (!bus->is_rounded && first_stop != last_stop) {
+                    doc.Add(MakeBusUnderlayer(last_stop->coordinates, bus->name));
+                    doc.Add(MakeBusName(last_stop->coordinates, color_index, bus->name));
                 }
             }
+            color_index = next_color(color_index);
         }
-        for (const std::string_view& stop_name : all_stops) { // Отрисовка кружков остановок
-            doc.Add(MakeStop(handler.GetStopCoordinates(stop_name)));
+        for (const domain::Stop* stop : handler.GetSortedStopsOnRoutes()) { // Отрисовка кружков остановок
+            doc.Add(MakeStop(stop->coordinates));
         }
-        for (const std::string_view& stop_name : all_stops) { // Отрисовка названий остановок
-            doc.Add(MakeStopUnderlayer(handler.GetStopCoordinates(stop_name), stop_name));
-            doc.Add(MakeStopName(handler.GetStopCoordinates(stop_name), stop_name));
+        for (const domain::Stop* stop : handler.GetSortedStopsOnRoutes()) { // Отрисовка названий остановок
+            doc.Add(MakeStopUnderlayer(stop->coordinates, stop->name));
+            doc.Add(MakeStopName(stop->coordinates, stop->name));
         }
     }
 
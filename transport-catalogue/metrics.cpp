@@ -0,0 +1,181 @@
+#include "metrics.h"
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+
+namespace metrics {
+
+    namespace detail {
+        std::atomic<bool> is_enabled = false;
+    }
+
+    namespace {
+
+        // Реестр создаётся при первом обращении, поэтому им можно пользоваться из статических переменных других файлов
+        struct Registry {
+            std::mutex mutex;
+            std::map<std::string, Histogram*, std::less<>> histograms;
+            std::map<std::string, Counter*, std::less<>> counters;
+            std::deque<Histogram> histogram_storage;
+            std::deque<Counter> counter_storage;
+        };
+
+        Registry& GetRegistry() {
+            static Registry registry;
+            return registry;
+        }
+
+        template <typename Metric>
+        Metric& Find(std::map<std::string, Metric*, std::less<>>& metrics, std::deque<Metric>& storage, std::string_view name) {
+            auto it = metrics.find(name);
+            if (it == metrics.end()) {
+                it = metrics.emplace(std::string(name), &storage.emplace_back()).first;
+            }
+            return *it->second;
+        }
+
+        double ToMicroseconds(std::chrono::nanoseconds duration) {
+            return duration.count() / 1000.0;
+        }
+
+        std::string& GetDumpPath() {
+            static std::string path;
+            return path;
+        }
+
+        void DumpToPath() {
+            const std::string& path = GetDumpPath();
+            if (path.empty()) {
+                Dump(std::cerr);
+                return;
+            }
+            std::ofstream output(path);
+            Dump(output);
+        }
+
+    } // namespace
+
+    void Enable() {
+        detail::is_enabled.store(true, std::memory_order_relaxed);
+    }
+
+    size_t Histogram::GetBucket(uint64_t value) {
+        // Значения меньше 2 * SUB_BUCKET_COUNT лежат в корзинах шириной 1
+        if (value < 2 * SUB_BUCKET_COUNT) {
+            return static_cast<size_t>(value);
+        }
+        if (value >= (uint64_t{ 1 } << MAX_EXPONENT)) {
+            return BUCKET_COUNT - 1;
+        }
+        size_t exponent = SUB_BUCKET_BITS + 1;
+        while ((value >> (exponent + 1)) != 0) {
+            ++exponent;
+        }
+        const size_t shift = exponent - SUB_BUCKET_BITS;
+        return shift * SUB_BUCKET_COUNT + static_cast<size_t>(value >> shift);
+    }
+
+    uint64_t Histogram::GetBucketMiddle(size_t bucket) {
+        if (bucket < 2 * SUB_BUCKET_COUNT) {
+            return bucket;
+        }
+        const size_t shift = bucket / SUB_BUCKET_COUNT - 1;
+        const uint64_t lower = static_cast<uint64_t>(bucket % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT) << shift;
+        return lower + (uint64_t{ 1 } << shift) / 2;
+    }
+
+    void Histogram::Record(std::chrono::nanoseconds duration) {
+        const uint64_t value = static_cast<uint64_t>(std::max<std::chrono::nanoseconds::rep>(duration.count(), 0));
+        buckets_[GetBucket(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        total_.fetch_add(value, std::memory_order_relaxed);
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t Histogram::GetCount() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    std::chrono::nanoseconds Histogram::GetTotal() const {
+        return std::chrono::nanoseconds(total_.load(std::memory_order_relaxed));
+    }
+
+    std::chrono::nanoseconds Histogram::GetMax() const {
+        return std::chrono::nanoseconds(max_.load(std::memory_order_relaxed));
+    }
+
+    std::chrono::nanoseconds Histogram::GetQuantile(double quantile) const {
+        const uint64_t count = GetCount();
+        if (count == 0) {
+            return std::chrono::nanoseconds(0);
+        }
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(quantile * count + 0.5));
+        uint64_t seen = 0;
+        for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+            seen += buckets_[bucket].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                const uint64_t max = max_.load(std::memory_order_relaxed);
+                return std::chrono::nanoseconds(std::min(GetBucketMiddle(bucket), max));
+            }
+        }
+        return GetMax();
+    }
+
+    Histogram& GetHistogram(std::string_view name) {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        return Find(registry.histograms, registry.histogram_storage, name);
+    }
+
+    Counter& GetCounter(std::string_view name) {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        return Find(registry.counters, registry.counter_storage, name);
+    }
+
+    void Dump(std::ostream& output) {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        const std::ios_base::fmtflags flags = output.flags();
+        const std::streamsize precision = output.precision();
+        output << std::fixed << std::setprecision(1);
+        output << "timings, us:\n";
+        for (const auto& [name, histogram] : registry.histograms) {
+            const uint64_t count = histogram->GetCount();
+            if (count == 0) {
+                continue;
+            }
+            output << "  " << std::left << std::setw(24) << name << std::right
+                << " count " << count
+                << "  total " << ToMicroseconds(histogram->GetTotal())
+                << "  mean " << ToMicroseconds(histogram->GetTotal()) / count
+                << "  p50 " << ToMicroseconds(histogram->GetQuantile(0.5))
+                << "  p90 " << ToMicroseconds(histogram->GetQuantile(0.9))
+                << "  p99 " << ToMicroseconds(histogram->GetQuantile(0.99))
+                << "  max " << ToMicroseconds(histogram->GetMax()) << '\n';
+        }
+        output << "counters:\n";
+        for (const auto& [name, counter] : registry.counters) {
+            if (counter->Get() != 0) {
+                output << "  " << std::left << std::setw(24) << name << std::right << ' ' << counter->Get() << '\n';
+            }
+        }
+        output.flags(flags);
+        output.precision(precision);
+    }
+
+    void DumpAtExit(std::string path) {
+        GetDumpPath() = std::move(path);
+        // Реестр должен быть создан раньше регистрации обработчика, иначе он будет разрушен до вывода сводки
+        GetRegistry();
+        Enable();
+        std::atexit(DumpToPath);
+    }
+
+} // namespace metrics
@@ -0,0 +1,111 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+namespace metrics {
+
+    using Clock = std::chrono::steady_clock;
+
+    namespace detail {
+        extern std::atomic<bool> is_enabled;
+    }
+
+    // Пока сбор выключен, таймеры не читают часы, а счётчики не пишут в память
+    inline bool IsEnabled() {
+        return detail::is_enabled.load(std::memory_order_relaxed);
+    }
+
+    void Enable();
+
+    /*
+     * Гистограмма длительностей в наносекундах в духе HDR: каждый интервал между соседними
+     * степенями двойки делится на 16 равных корзин, поэтому относительная погрешность квантилей
+     * не больше 1/16 при любом масштабе значений. Корзины атомарные, запись из нескольких
+     * потоков идёт без блокировок
+     */
+    class Histogram {
+    public:
+        void Record(std::chrono::nanoseconds duration);
+        uint64_t GetCount() const;
+        std::chrono::nanoseconds GetTotal() const;
+        std::chrono::nanoseconds GetMax() const;
+        // Оценка квантиля quantile из [0, 1] по середине корзины, в которую он попал
+        std::chrono::nanoseconds GetQuantile(double quantile) const;
+    private:
+        static constexpr size_t SUB_BUCKET_BITS = 4;
+        static constexpr size_t SUB_BUCKET_COUNT = size_t{ 1 } << SUB_BUCKET_BITS;
+        // Значения от 2^40 нс (около 18 минут) попадают в последнюю, отдельную корзину
+        static constexpr size_t MAX_EXPONENT = 40;
+        static constexpr size_t BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT + 1;
+
+        std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets_{};
+        std::atomic<uint64_t> count_ = 0;
+        std::atomic<uint64_t> total_ = 0;
+        std::atomic<uint64_t> max_ = 0;
+
+        static size_t GetBucket(uint64_t value);
+        static uint64_t GetBucketMiddle(size_t bucket);
+    };
+
+    // Счётчик событий; Set подходит для величин вроде размеров графа, которые задаются один раз
+    class Counter {
+    public:
+        void Add(uint64_t value = 1) {
+            if (IsEnabled()) {
+                value_.fetch_add(value, std::memory_order_relaxed);
+            }
+        }
+
+        void Set(uint64_t value) {
+            if (IsEnabled()) {
+                value_.store(value, std::memory_order_relaxed);
+            }
+        }
+
+        uint64_t Get() const {
+            return value_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<uint64_t> value_ = 0;
+    };
+
+    // Гистограммы и счётчики живут до конца процесса, ссылки на них можно сохранять в статических переменных
+    Histogram& GetHistogram(std::string_view name);
+    Counter& GetCounter(std::string_view name);
+
+    // Записывает в гистограмму время жизни объекта; при выключенном сборе ничего не делает
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Histogram& histogram)
+            : histogram_(IsEnabled() ? &histogram : nullptr) {
+            if (histogram_ != nullptr) {
+                start_ = Clock::now();
+            }
+        }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+        ~ScopedTimer() {
+            if (histogram_ != nullptr) {
+                histogram_->Record(Clock::now() - start_);
+            }
+        }
+
+    private:
+        Histogram* histogram_;
+        Clock::time_point start_;
+    };
+
+    // Сводка по всем непустым гистограммам и ненулевым счётчикам в порядке имён
+    void Dump(std::ostream& output);
+    // Включает сбор и выводит сводку при завершении процесса: в файл path или, если он пуст, в stderr
+    void DumpAtExit(std::string path);
+
+} // namespace metrics
@@ -0,0 +1,37 @@
+#include "name_arena.h"
+#include <algorithm>
+#include <functional>
+
+namespace domain {
+
+    std::string_view NameArena::Intern(std::string_view name) {
+        if (IsInLastBlock(name)) {
+            return name;
+        }
+        if (blocks_.empty() || blocks_.back().capacity() - blocks_.back().size() < name.size()) {
+            blocks_.emplace_back();
+            blocks_.back().reserve(std::max(BLOCK_SIZE, name.size()));
+        }
+        // Дописывание в пределах зарезервированной ёмкости не приводит к перераспределению памяти
+        std::string& block = blocks_.back();
+        const size_t offset = block.size();
+        block.append(name);
+        return std::string_view(block.data() + offset, name.size());
+    }
+
+    std::string_view NameArena::Adopt(std::string&& blob) {
+        blocks_.push_back(std::move(blob));
+        return blocks_.back();
+    }
+
+    bool NameArena::IsInLastBlock(std::string_view name) const {
+        if (blocks_.empty()) {
+            return false;
+        }
+        const std::less<const char*> less;
+        const char* begin = blocks_.back().data();
+        const char* end = begin + blocks_.back().size();
+        return !less(name.data(), begin) && !less(end, name.data() + name.size());
+    }
+
+} // namespace domain
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+
+namespace domain {
+
+    /*
+     * Непрерывное хранилище названий остановок и маршрутов, в которое можно только дописывать.
+     * Имена копируются в крупные блоки, а наружу отдаются string_view, которые остаются
+     * валидными всё время жизни арены (в том числе после её перемещения).
+     */
+    class NameArena {
+    public:
+        NameArena() = default;
+        NameArena(const NameArena&) = delete;
+        NameArena& operator=(const NameArena&) = delete;
+        NameArena(NameArena&&) = default;
+        NameArena& operator=(NameArena&&) = default;
+
+        // Копирует имя в арену. Если имя уже лежит в последнем блоке арены (так бывает с именами
+        // из блока, переданного через Adopt), возвращает его без копирования
+        std::string_view Intern(std::string_view name);
+        // Забирает готовый блок имён целиком, например загруженный из базы
+        std::string_view Adopt(std::string&& blob);
+
+    private:
+        static constexpr size_t BLOCK_SIZE = 64 * 1024;
+        // deque не перемещает уже добавленные блоки, поэтому выданные string_view не инвалидируются
+        std::deque<std::string> blocks_;
+
+        // Проверяется только последний блок, чтобы стоимость Intern не росла вместе с ареной
+        bool IsInLastBlock(std::string_view name) const;
+    };
+
+} // namespace domain
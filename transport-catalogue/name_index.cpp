@@ -0,0 +1,136 @@
+#include "name_index.h"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+using namespace std::literals;
+
+namespace domain {
+
+    namespace {
+
+        // FNV-1a с перемешиванием из MurmurHash3, чтобы разные затравки давали независимые значения
+        uint64_t HashName(std::string_view name, uint64_t seed) {
+            uint64_t hash = 14695981039346656037ULL ^ (seed * 0x9E3779B97F4A7C15ULL);
+            for (char c : name) {
+                hash ^= static_cast<unsigned char>(c);
+                hash *= 1099511628211ULL;
+            }
+            hash ^= hash >> 33;
+            hash *= 0xFF51AFD7ED558CCDULL;
+            hash ^= hash >> 33;
+            hash *= 0xC4CEB93E53B22D8DULL;
+            hash ^= hash >> 33;
+            return hash;
+        }
+
+        // За столько затравок корзина из нескольких различных имён размещается с подавляющей вероятностью
+        constexpr int32_t MAX_SEED = 1 << 20;
+
+    } // namespace
+
+    FrozenNameIndex::FrozenNameIndex(std::vector<int32_t> displacements, std::vector<uint32_t> slots)
+        : displacements_(std::move(displacements)),
+        slots_(std::move(slots))
+    {
+    }
+
+    FrozenNameIndex FrozenNameIndex::Build(const std::vector<std::pair<std::string_view, uint32_t>>& items) {
+        const size_t size = items.size();
+        if (size == 0) {
+            return {};
+        }
+        std::vector<std::vector<uint32_t>> buckets(size);
+        for (uint32_t i = 0; i < size; ++i) {
+            buckets[HashName(items[i].first, 0) % size].push_back(i);
+        }
+        std::vector<uint32_t> order(size);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&buckets](uint32_t lhs, uint32_t rhs) {
+            return buckets[lhs].size() > buckets[rhs].size();
+            });
+
+        std::vector<int32_t> displacements(size, 0);
+        std::vector<uint32_t> slots(size, NPOS);
+        std::vector<bool> occupied(size, false);
+        std::vector<size_t> positions;
+        size_t bucket_pos = 0;
+        // Корзины с несколькими именами: подбираем затравку, разводящую их по свободным ячейкам
+        for (; bucket_pos < size && buckets[order[bucket_pos]].size() > 1; ++bucket_pos) {
+            const std::vector<uint32_t>& bucket = buckets[order[bucket_pos]];
+            // Одинаковые имена попадают в одну корзину, и никакая затравка их не разведёт
+            for (size_t i = 0; i < bucket.size(); ++i) {
+                for (size_t j = i + 1; j < bucket.size(); ++j) {
+                    if (items[bucket[i]].first == items[bucket[j]].first) {
+                        throw std::invalid_argument("Duplicate name in name index: "s + std::string(items[bucket[i]].first));
+                    }
+                }
+            }
+            int32_t seed = 1;
+            for (; seed <= MAX_SEED; ++seed) {
+                positions.clear();
+                bool placed = true;
+                for (uint32_t item : bucket) {
+                    const size_t position = HashName(items[item].first, seed) % size;
+                    if (occupied[position] || std::find(positions.begin(), positions.end(), position) != positions.end()) {
+                        placed = false;
+                        break;
+                    }
+                    positions.push_back(position);
+                }
+                if (placed) {
+                    displacements[order[bucket_pos]] = seed;
+                    for (size_t i = 0; i < bucket.size(); ++i) {
+                        occupied[positions[i]] = true;
+                        slots[positions[i]] = items[bucket[i]].second;
+                    }
+                    break;
+                }
+            }
+            if (seed > MAX_SEED) {
+                throw std::runtime_error("Failed to build name index: no seed places a bucket of "s + std::to_string(bucket.size()) + " names"s);
+            }
+        }
+        // Корзины из одного имени занимают оставшиеся ячейки напрямую
+        size_t free_position = 0;
+        for (; bucket_pos < size && buckets[order[bucket_pos]].size() == 1; ++bucket_pos) {
+            while (occupied[free_position]) {
+                ++free_position;
+            }
+            occupied[free_position] = true;
+            slots[free_position] = items[buckets[order[bucket_pos]].front()].second;
+            displacements[order[bucket_pos]] = -static_cast<int32_t>(free_position) - 1;
+        }
+        return FrozenNameIndex(std::move(displacements), std::move(slots));
+    }
+
+    uint32_t FrozenNameIndex::FindCandidate(std::string_view key) const {
+        if (slots_.empty() || displacements_.empty()) {
+            return NPOS;
+        }
+        const int32_t displacement = displacements_[HashName(key, 0) % displacements_.size()];
+        const size_t position = displacement < 0
+            ? static_cast<size_t>(-(displacement + 1))
+            : HashName(key, displacement) % slots_.size();
+        return position < slots_.size() ? slots_[position] : NPOS;
+    }
+
+    bool FrozenNameIndex::IsValid() const {
+        if (displacements_.size() != slots_.size()) {
+            return false;
+        }
+        return std::all_of(displacements_.begin(), displacements_.end(), [this](int32_t displacement) {
+            return displacement >= 0 || static_cast<size_t>(-(static_cast<int64_t>(displacement) + 1)) < slots_.size();
+            });
+    }
+
+    const std::vector<int32_t>& FrozenNameIndex::GetDisplacements() const {
+        return displacements_;
+    }
+
+    const std::vector<uint32_t>& FrozenNameIndex::GetSlots() const {
+        return slots_;
+    }
+
+} // namespace domain
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace domain {
+
+    /*
+     * Минимальная совершенная хеш-функция над неизменяемым набором имён (схема hash and displace).
+     * Каждое имя попадает в корзину по первому хешу, а для корзины подобрано смещение, при котором
+     * все её имена занимают свободные ячейки таблицы. Поиск — не больше двух хешей без проб,
+     * после чего вызывающий сравнивает имя найденного кандидата с искомым.
+     */
+    class FrozenNameIndex {
+    public:
+        static constexpr uint32_t NPOS = std::numeric_limits<uint32_t>::max();
+
+        FrozenNameIndex() = default;
+        // Массивы берутся как есть; пригодность данных из внешнего источника проверяет IsValid
+        FrozenNameIndex(std::vector<int32_t> displacements, std::vector<uint32_t> slots);
+
+        // Имена в items должны быть уникальны, второй элемент пары — номер объекта с этим именем.
+        // Бросает std::invalid_argument, если имена повторяются
+        static FrozenNameIndex Build(const std::vector<std::pair<std::string_view, uint32_t>>& items);
+
+        // Возвращает номер единственного объекта, который может носить имя key, или NPOS для пустого индекса
+        uint32_t FindCandidate(std::string_view key) const;
+
+        // Индекс из Build всегда пригоден: корзин столько же, сколько ячеек, и смещения указывают в таблицу
+        bool IsValid() const;
+
+        const std::vector<int32_t>& GetDisplacements() const;
+        const std::vector<uint32_t>& GetSlots() const;
+
+    private:
+        // Отрицательное смещение -(i + 1) указывает ячейку i для корзины из одного имени
+        std::vector<int32_t> displacements_;
+        std::vector<uint32_t> slots_;
+    };
+
+} // namespace domain
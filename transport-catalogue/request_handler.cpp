@@ -1,9 +1,223 @@
-#include "json_builder.h"
 #include "request_handler.h"
+#include "metrics.h"
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <limits>
+#include <memory>
 #include <sstream>
+#include <thread>
+#include <unordered_map>
 
 namespace request_handler {
 
+	namespace {
+
+		// Гистограммы времени ответа по типам запросов; ссылки на них берутся из реестра один раз
+		struct RequestHistograms {
+			metrics::Histogram& bus = metrics::GetHistogram("request.Bus");
+			metrics::Histogram& stop = metrics::GetHistogram("request.Stop");
+			metrics::Histogram& map = metrics::GetHistogram("request.Map");
+			metrics::Histogram& route = metrics::GetHistogram("request.Route");
+			metrics::Histogram& route_from_point = metrics::GetHistogram("request.RouteFromPoint");
+			metrics::Histogram& nearest_stops = metrics::GetHistogram("request.NearestStops");
+			metrics::Histogram& stops_in_box = metrics::GetHistogram("request.StopsInBox");
+		};
+
+		const RequestHistograms& GetRequestHistograms() {
+			static const RequestHistograms histograms;
+			return histograms;
+		}
+
+		struct BatchMetrics {
+			metrics::Histogram& batch = metrics::GetHistogram("stat.batch");
+			metrics::Counter& requests = metrics::GetCounter("stat.requests");
+			metrics::Counter& duplicates = metrics::GetCounter("stat.duplicates");
+		};
+
+		const BatchMetrics& GetBatchMetrics() {
+			static const BatchMetrics batch_metrics;
+			return batch_metrics;
+		}
+
+	} // namespace
+
+	/*
+	 * Ответы на повторяющиеся запросы пакета. Запросы Bus, Stop и Route с одинаковыми параметрами
+	 * вычисляются один раз, остальным достаётся тот же текст ответа с подставленным request_id.
+	 * Пакет, прочитанный целиком, известен заранее: ответ хранится, только пока в нём остаются такие же запросы.
+	 * Пакет, который читается блоками, заранее не известен, поэтому ответы хранятся и для следующих блоков,
+	 * пока их текст не превысит MAX_KEPT_BYTES. Сверх этого новый ответ хранится, только пока его ждут
+	 * такие же запросы уже прочитанных блоков
+	 */
+	class RequestHandler::DuplicateAnswers {
+	public:
+		// Для пакета, который читается блоками: запросы каждого блока передаются в AddRequests
+		DuplicateAnswers()
+			: keeps_answers_(true) {
+		}
+
+		explicit DuplicateAnswers(const json::LazyArray& requests) {
+			AddRequests(requests);
+		}
+
+		void AddRequests(const json::LazyArray& requests) {
+			std::unordered_map<Key, size_t, KeyHasher> counts;
+			for (const json::LazyNode& request : requests) {
+				++request_count_;
+				if (const std::optional<Key> key = MakeKey(request)) {
+					++counts[*key];
+				}
+			}
+			for (const auto& [key, count] : counts) {
+				if (const auto it = answers_.find(key); it != answers_.end()) {
+					it->second.uses_left += count;
+				}
+				else if (count > 1 || (keeps_answers_ && kept_bytes_ < MAX_KEPT_BYTES)) {
+					Insert(key).uses_left = count;
+				}
+			}
+			has_duplicates_ = !answers_.empty();
+		}
+
+		struct Key {
+			std::string_view type;
+			std::string_view first;
+			std::string_view second;
+
+			bool operator==(const Key& other) const {
+				return type == other.type && first == other.first && second == other.second;
+			}
+		};
+
+		// Ключ, по которому ищется ответ на такой же запрос; пустой, если повторов нет или запрос другого типа.
+		// Вычисляется один раз на запрос и передаётся в TryWrite и Store
+		std::optional<Key> FindKey(const json::LazyNode& request) const {
+			if (!has_duplicates_) {
+				return std::nullopt;
+			}
+			return MakeKey(request);
+		}
+
+		// Пишет готовый ответ на такой же запрос; false, если его ещё нет
+		bool TryWrite(const Key& key, const json::LazyNode& request, json::Writer& writer) {
+			std::string answer;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				auto it = answers_.find(key);
+				if (it == answers_.end() || !it->second.is_ready) {
+					return false;
+				}
+				answer.reserve(it->second.prefix.size() + it->second.suffix.size() + 16);
+				answer.append(it->second.prefix)
+					.append(std::to_string(request.AsMap().at("id").AsInt()))
+					.append(it->second.suffix);
+				++duplicate_count_;
+				Use(it);
+			}
+			writer.Raw(answer);
+			return true;
+		}
+
+		// Запоминает записанный ответ, если в пакете есть такие же запросы
+		void Store(const Key& key, std::string_view answer) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto it = answers_.find(key);
+			if (it == answers_.end()) {
+				return;
+			}
+			if (!it->second.is_ready) {
+				// В тексте ответа ключ "request_id" с кавычкой и двоеточием встречается только один раз:
+				// кавычки внутри строк экранированы, а вложенные словари такого ключа не имеют
+				static constexpr std::string_view REQUEST_ID = "\"request_id\":";
+				if (!answer.empty() && answer.front() == ',') {
+					answer.remove_prefix(1);
+				}
+				const size_t id_begin = answer.find(REQUEST_ID);
+				if (id_begin != std::string_view::npos) {
+					const size_t number_begin = id_begin + REQUEST_ID.size();
+					const size_t number_end = answer.find_first_not_of("-0123456789", number_begin);
+					it->second.prefix = answer.substr(0, number_begin);
+					it->second.suffix = answer.substr(number_end);
+					it->second.is_ready = true;
+					kept_bytes_ += it->second.prefix.size() + it->second.suffix.size();
+				}
+			}
+			Use(it);
+		}
+
+		BatchStats GetStats() const {
+			return { request_count_, duplicate_count_ };
+		}
+
+	private:
+		struct KeyHasher {
+			size_t operator()(const Key& key) const {
+				const std::hash<std::string_view> hasher;
+				return hasher(key.type) + 37 * hasher(key.first) + 37 * 37 * hasher(key.second);
+			}
+		};
+
+		// Текст ответа до номера запроса и после него
+		struct Answer {
+			std::string prefix;
+			std::string suffix;
+			// Копия параметров запроса, на которую указывает ключ, если ответ переживает документ своего блока
+			std::unique_ptr<std::string> key_text;
+			size_t uses_left = 0;
+			bool is_ready = false;
+		};
+
+		static constexpr size_t MAX_KEPT_BYTES = 1 << 20;
+
+		std::mutex mutex_;
+		std::unordered_map<Key, Answer, KeyHasher> answers_;
+		bool keeps_answers_ = false;
+		bool has_duplicates_ = false;
+		size_t kept_bytes_ = 0;
+		size_t request_count_ = 0;
+		size_t duplicate_count_ = 0;
+
+		Answer& Insert(const Key& key) {
+			if (!keeps_answers_) {
+				// Документ пакета живёт дольше ответов, ключ может указывать прямо в его текст
+				return answers_[key];
+			}
+			auto key_text = std::make_unique<std::string>();
+			key_text->reserve(key.type.size() + key.first.size() + key.second.size());
+			key_text->append(key.type).append(key.first).append(key.second);
+			const std::string_view text = *key_text;
+			const Key own_key{ text.substr(0, key.type.size()), text.substr(key.type.size(), key.first.size()), text.substr(key.type.size() + key.first.size()) };
+			kept_bytes_ += text.size();
+			Answer& answer = answers_[own_key];
+			answer.key_text = std::move(key_text);
+			return answer;
+		}
+
+		static std::optional<Key> MakeKey(const json::LazyNode& request) {
+			const json::LazyMap map = request.AsMap();
+			const std::string_view type = map.at("type").AsString();
+			if (type == "Bus" || type == "Stop") {
+				return Key{ type, map.at("name").AsString(), {} };
+			}
+			if (type == "Route") {
+				return Key{ type, map.at("from").AsString(), map.at("to").AsString() };
+			}
+			return std::nullopt;
+		}
+
+		// Каждый запрос с ключом расходует ответ ровно один раз: берёт готовый или записывает свой
+		void Use(std::unordered_map<Key, Answer, KeyHasher>::iterator it) {
+			if (--it->second.uses_left != 0 || (keeps_answers_ && kept_bytes_ <= MAX_KEPT_BYTES)) {
+				return;
+			}
+			if (keeps_answers_) {
+				kept_bytes_ -= it->second.prefix.size() + it->second.suffix.size() + it->second.key_text->size();
+			}
+			answers_.erase(it);
+		}
+	};
+
 	RequestHandler::RequestHandler(transport_catalogue::TransportCatalogue& db, renderer::MapRenderer& renderer)
 		: db_(db),
 		renderer_(renderer)
@@ -30,6 +244,12 @@ namespace request_handler {
 	const geo::Coordinates RequestHandler::GetStopCoordinates(const std::string_view stop_name) const {
 		return db_.GetStopCoordinates(stop_name);
 	}
+	transport_catalogue::TransportCatalogue::BusesRange RequestHandler::GetSortedBuses() const {
+		return db_.GetSortedBuses();
+	}
+	transport_catalogue::TransportCatalogue::StopsRange RequestHandler::GetSortedStopsOnRoutes() const {
+		return db_.GetSortedStopsOnRoutes();
+	}
 
 	void RequestHandler::RenderMap(svg::Document& doc) {
 		renderer_.RenderMap(*this, doc);
@@ -84,70 +304,291 @@ namespace request_handler {
 		renderer_.SetColorPalette(color_palette);
 	}
 
-	json::Node RequestHandler::MakeJsonOutputBus(const json::Node& node) {
+	// Ключи словарей выводятся в алфавитном порядке, как их раньше упорядочивал json::Dict
+	void RequestHandler::MakeJsonOutputNotFound(const json::LazyNode& node, json::Writer& writer) {
+		writer.StartDict()
+			.Key("error_message").String("not found")
+			.Key("request_id").Int(node.AsMap().at("id").AsInt())
+			.EndDict();
+	}
+
+	void RequestHandler::MakeJsonOutputBus(const json::LazyNode& node, json::Writer& writer) {
 		auto request_result = GetBusStat(node.AsMap().at("name").AsString());
-		if (request_result) {
-			return json::Builder{}.StartDict()
-				.Key("request_id").Value(node.AsMap().at("id").AsInt())
-				.Key("stop_count").Value(static_cast<int>(request_result.value().stops_count))
-				.Key("unique_stop_count").Value(static_cast<int>(request_result.value().unique_stops_count))
-				.Key("route_length").Value(request_result.value().distance)
-				.Key("curvature").Value(request_result.value().curvature)
-				.EndDict().Build();
-		}
-		return json::Builder{}.StartDict()
-			.Key("request_id").Value(node.AsMap().at("id").AsInt())
-			.Key("error_message").Value(std::string("not found"))
-			.EndDict().Build();
-	}
-
-	json::Node RequestHandler::MakeJsonOutputStop(const json::Node& node) {
-		auto request_result = GetBusesByStop(node.AsMap().at("name").AsString());
 		if (!request_result) {
-			return json::Builder{}.StartDict()
-				.Key("request_id").Value(node.AsMap().at("id").AsInt())
-				.Key("error_message").Value(std::string("not found"))
-				.EndDict().Build();
+			MakeJsonOutputNotFound(node, writer);
+			return;
 		}
-		json::Array buses;
-		for (const auto& bus : request_result.value()) {
-			buses.push_back(json::Node(std::string(bus)));
+		writer.StartDict()
+			.Key("curvature").Double(request_result.value().curvature)
+			.Key("request_id").Int(node.AsMap().at("id").AsInt())
+			.Key("route_length").Double(request_result.value().distance)
+			.Key("stop_count").Int(static_cast<int>(request_result.value().stops_count))
+			.Key("unique_stop_count").Int(static_cast<int>(request_result.value().unique_stops_count))
+			.EndDict();
+	}
+
+	void RequestHandler::MakeJsonOutputStop(const json::LazyNode& node, json::Writer& writer) {
+		auto request_result = db_.BusesOnStopView(node.AsMap().at("name").AsString());
+		if (!request_result) {
+			MakeJsonOutputNotFound(node, writer);
+			return;
 		}
-		return json::Builder{}.StartDict()
-			.Key("request_id").Value(node.AsMap().at("id").AsInt())
-			.Key("buses").Value(buses)
-			.EndDict().Build();
+		writer.StartDict().Key("buses").StartArray();
+		for (std::string_view bus : *request_result) {
+			writer.String(bus);
+		}
+		writer.EndArray()
+			.Key("request_id").Int(node.AsMap().at("id").AsInt())
+			.EndDict();
 	}
 
-	json::Node RequestHandler::MakeJsonOutputMap(const json::Node& node, svg::Document& map) {
+	void RequestHandler::RenderMapTo(std::ostream& output) {
+		static metrics::Histogram& render_histogram = metrics::GetHistogram("map.render");
+		const std::lock_guard<std::mutex> lock(render_mutex_);
+		const metrics::ScopedTimer timer(render_histogram);
+		svg::Document map;
 		RenderMap(map);
-		std::ostringstream strm;
-		map.Render(strm);
-		return json::Builder{}.StartDict()
-			.Key("request_id").Value(node.AsMap().at("id").AsInt())
-			.Key("map").Value(json::Node(strm.str()).AsString())
-			.EndDict().Build();
+		map.Render(output);
 	}
 
-	json::Array RequestHandler::ParseStatRequests(const json::Node& array) {
-		json::Array requests;
-		for (const json::Node& node : array.AsArray()) {
-			std::string request = node.AsMap().at("type").AsString();
-			if (request == "Bus") {
-				requests.push_back(MakeJsonOutputBus(node));
+	const std::string& RequestHandler::GetMapSvg() {
+		std::call_once(map_svg_once_, [this]() {
+			std::ostringstream output;
+			RenderMapTo(output);
+			map_svg_ = output.str();
+		});
+		return map_svg_;
+	}
+
+	void RequestHandler::MakeJsonOutputMap(const json::LazyNode& node, json::Writer& writer) {
+		std::call_once(map_json_once_, [this]() {
+			// SVG экранируется прямо при выводе, без промежуточной копии всего текста карты
+			json::Writer map_writer;
+			map_writer.String([this](std::ostream& output) {
+				RenderMapTo(output);
+			});
+			map_json_ = map_writer.GetBuffer();
+		});
+		writer.StartDict()
+			.Key("map").Raw(map_json_)
+			.Key("request_id").Int(node.AsMap().at("id").AsInt())
+			.EndDict();
+	}
+
+	bool RequestHandler::ParseStatRequest(const json::LazyNode& node, json::Writer& writer) {
+		const RequestHistograms& histograms = GetRequestHistograms();
+		std::string_view request = node.AsMap().at("type").AsString();
+		if (request == "Bus") {
+			const metrics::ScopedTimer timer(histograms.bus);
+			MakeJsonOutputBus(node, writer);
+		}
+		else if (request == "Stop") {
+			const metrics::ScopedTimer timer(histograms.stop);
+			MakeJsonOutputStop(node, writer);
+		}
+		else if (request == "Map") {
+			const metrics::ScopedTimer timer(histograms.map);
+			MakeJsonOutputMap(node, writer);
+		}
+		else if (request == "Route") {
+			const metrics::ScopedTimer timer(histograms.route);
+			MakeJsonOutputRoute(node, router_.BuildRoute(node.AsMap().at("from").AsString(), node.AsMap().at("to").AsString()), writer);
+		}
+		else if (request == "RouteFromPoint") {
+			const metrics::ScopedTimer timer(histograms.route_from_point);
+			MakeJsonOutputRouteFromPoint(node, writer);
+		}
+		else if (request == "NearestStops") {
+			const metrics::ScopedTimer timer(histograms.nearest_stops);
+			MakeJsonOutputNearestStops(node, writer);
+		}
+		else if (request == "StopsInBox") {
+			const metrics::ScopedTimer timer(histograms.stops_in_box);
+			MakeJsonOutputStopsInBox(node, writer);
+		}
+		else {
+			return false;
+		}
+		return true;
+	}
+
+	bool RequestHandler::ParseStatRequest(const json::LazyNode& node, json::Writer& writer, DuplicateAnswers& duplicates) {
+		const std::optional<DuplicateAnswers::Key> key = duplicates.FindKey(node);
+		if (key && duplicates.TryWrite(*key, node, writer)) {
+			return true;
+		}
+		const size_t answer_begin = writer.GetBuffer().size();
+		if (!ParseStatRequest(node, writer)) {
+			return false;
+		}
+		if (key) {
+			duplicates.Store(*key, writer.GetBuffer().substr(answer_begin));
+		}
+		return true;
+	}
+
+	BatchStats RequestHandler::ParseStatRequests(const json::LazyArray& requests, std::ostream& output, size_t threads) {
+		const BatchMetrics& batch_metrics = GetBatchMetrics();
+		const metrics::ScopedTimer timer(batch_metrics.batch);
+		DuplicateAnswers duplicates(requests);
+		json::Writer writer;
+		writer.StartArray();
+		AnswerBlock(requests, duplicates, writer, output, threads);
+		writer.EndArray();
+		writer.Flush(output);
+		const BatchStats stats = duplicates.GetStats();
+		batch_metrics.requests.Add(stats.request_count);
+		batch_metrics.duplicates.Add(stats.duplicate_count);
+		return stats;
+	}
+
+	RequestHandler::BatchStream::BatchStream(RequestHandler& handler, std::ostream& output, size_t threads)
+		: handler_(handler),
+		output_(output),
+		threads_(threads),
+		duplicates_(std::make_unique<DuplicateAnswers>()),
+		timer_(GetBatchMetrics().batch)
+	{
+		writer_.StartArray();
+	}
+
+	RequestHandler::BatchStream::~BatchStream() = default;
+
+	void RequestHandler::BatchStream::Answer(const json::LazyArray& requests) {
+		duplicates_->AddRequests(requests);
+		handler_.AnswerBlock(requests, *duplicates_, writer_, output_, threads_);
+	}
+
+	BatchStats RequestHandler::BatchStream::Finish() {
+		writer_.EndArray();
+		writer_.Flush(output_);
+		const BatchStats stats = duplicates_->GetStats();
+		GetBatchMetrics().requests.Add(stats.request_count);
+		GetBatchMetrics().duplicates.Add(stats.duplicate_count);
+		return stats;
+	}
+
+	void RequestHandler::AnswerBlock(const json::LazyArray& requests, DuplicateAnswers& duplicates, json::Writer& writer, std::ostream& output, size_t threads) {
+		// Маршрутизатор строится до ответов на запросы, и дальше все потоки только читают его
+		if (!router_.IsPrepared()) {
+			for (const json::LazyNode& request : requests) {
+				const std::string_view type = request.AsMap().at("type").AsString();
+				if (type == "Route" || type == "RouteFromPoint") {
+					router_.Prepare(db_);
+					break;
+				}
 			}
-			else if (request == "Stop") {
-				requests.push_back(MakeJsonOutputStop(node));
+		}
+		if (threads > 1) {
+			ParseStatRequestsInParallel(requests, duplicates, writer, output, threads);
+		}
+		else {
+			for (const json::LazyNode& request : requests) {
+				if (ParseStatRequest(request, writer, duplicates)) {
+					writer.Flush(output);
+				}
 			}
-			else if (request == "Map") {
-				svg::Document map;
-				requests.push_back(MakeJsonOutputMap(node, map));
+		}
+	}
+
+	/*
+	 * Запросы делятся на блоки по CHUNK_SIZE. Свободный поток берёт очередной блок из общей очереди,
+	 * так что долгий запрос задерживает только свой блок, а остальные блоки разбирают другие потоки.
+	 * Ответы блока пишутся в его ячейку, и ячейки выводятся строго по порядку. Потоки уходят вперёд
+	 * от вывода не больше чем на WINDOW_CHUNKS_PER_THREAD блоков каждый, поэтому память под
+	 * готовые ответы ограничена и для пакетов из миллионов запросов
+	 */
+	void RequestHandler::ParseStatRequestsInParallel(const json::LazyArray& requests, DuplicateAnswers& duplicates, json::Writer& writer, std::ostream& output, size_t threads) {
+		static constexpr size_t CHUNK_SIZE = 64;
+		static constexpr size_t WINDOW_CHUNKS_PER_THREAD = 8;
+
+		std::vector<json::LazyNode> items;
+		items.reserve(requests.size());
+		for (const json::LazyNode& request : requests) {
+			items.push_back(request);
+		}
+		const size_t chunk_count = (items.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+		threads = std::min(threads, std::max<size_t>(chunk_count, 1));
+		const size_t window = threads * WINDOW_CHUNKS_PER_THREAD;
+
+		std::vector<std::string> slots(chunk_count);
+		std::vector<bool> is_ready(chunk_count, false);
+		size_t next_chunk = 0;
+		size_t written_chunks = 0;
+		std::exception_ptr error;
+		std::mutex mutex;
+		std::condition_variable chunk_ready;
+		std::condition_variable window_moved;
+
+		auto worker = [&]() {
+			json::Writer chunk_writer;
+			while (true) {
+				size_t chunk = 0;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					window_moved.wait(lock, [&]() {
+						return error || next_chunk == chunk_count || next_chunk < written_chunks + window;
+					});
+					if (error || next_chunk == chunk_count) {
+						return;
+					}
+					chunk = next_chunk++;
+				}
+				std::string answers;
+				try {
+					chunk_writer.Clear();
+					const size_t end = std::min(items.size(), (chunk + 1) * CHUNK_SIZE);
+					for (size_t i = chunk * CHUNK_SIZE; i < end; ++i) {
+						ParseStatRequest(items[i], chunk_writer, duplicates);
+					}
+					answers = chunk_writer.GetBuffer();
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock(mutex);
+					if (!error) {
+						error = std::current_exception();
+					}
+					chunk_ready.notify_one();
+					window_moved.notify_all();
+					return;
+				}
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					slots[chunk] = std::move(answers);
+					is_ready[chunk] = true;
+				}
+				chunk_ready.notify_one();
 			}
-			else if (request == "Route") {
-				requests.push_back(MakeJsonOutputRoute(node, router_.BuildRoute(db_, node.AsMap().at("from").AsString(), node.AsMap().at("to").AsString())));
+		};
+
+		std::vector<std::thread> pool;
+		pool.reserve(threads);
+		for (size_t i = 0; i < threads; ++i) {
+			pool.emplace_back(worker);
+		}
+		for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+			std::string answers;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				chunk_ready.wait(lock, [&]() {
+					return error || is_ready[chunk];
+				});
+				if (error) {
+					break;
+				}
+				answers = std::move(slots[chunk]);
+				written_chunks = chunk + 1;
 			}
+			window_moved.notify_all();
+			writer.Raw(answers);
+			writer.Flush(output);
+		}
+		for (std::thread& thread : pool) {
+			thread.join();
+		}
+		if (error) {
+			std::rethrow_exception(error);
 		}
-		return requests;
 	}
 
 	void RequestHandler::SetBusVelocity(int velocity) {
@@ -156,64 +597,197 @@ namespace request_handler {
 	void RequestHandler::SetBusWaitTime(int time) {
 		router_.SetBusWaitTime(time);
 	}
+	void RequestHandler::SetPedestrianVelocity(double velocity) {
+		router_.SetPedestrianVelocity(velocity);
+	}
 
-	void RequestHandler::BuildGraph() {
-		router_.BuildGraph(db_);
+	void RequestHandler::PrepareRouter() {
+		router_.Prepare(db_);
 	}
 
-	json::Node RequestHandler::MakeJsonOutputRoute(const json::Node& node, std::optional<std::vector<transport_router::EdgeInfo>> info) {
+	void RequestHandler::MakeJsonOutputRoute(const json::LazyNode& node, const std::optional<std::vector<transport_router::EdgeInfo>>& info, json::Writer& writer) {
 		if (!info.has_value()) {
-			return json::Builder{}.StartDict()
-				.Key("request_id").Value(node.AsMap().at("id").AsInt())
-				.Key("error_message").Value("not found")
-				.EndDict().Build();
-		}
-		if (info.value().size() == 0) {
-			return json::Builder{}.StartDict()
-				.Key("request_id").Value(node.AsMap().at("id").AsInt())
-				.Key("total_time").Value(0)
-				.Key("items").StartArray().EndArray()
-				.EndDict().Build();
-		}
-		json::Array items;
+			MakeJsonOutputNotFound(node, writer);
+			return;
+		}
+		writer.StartDict().Key("items").StartArray();
 		double total_time = 0;
 		for (const auto& edge_info : info.value()) {
 			total_time += edge_info.time;
+			writer.StartDict();
 			if (edge_info.type == "Wait") {
-				items.push_back(json::Builder{}.StartDict()
-					.Key("type").Value(edge_info.type)
-					.Key("stop_name").Value(edge_info.stop_name)
-					.Key("time").Value(edge_info.time)
-					.EndDict().Build());
+				writer.Key("stop_name").String(edge_info.stop_name)
+					.Key("time").Double(edge_info.time);
+			}
+			else if (edge_info.type == "Walk") {
+				// У пешего маршрута от точки до точки остановки нет
+				if (!edge_info.stop_name.empty()) {
+					writer.Key("stop_name").String(edge_info.stop_name);
+				}
+				writer.Key("time").Double(edge_info.time);
 			}
 			else {
-				items.push_back(json::Builder{}.StartDict()
-					.Key("type").Value(edge_info.type)
-					.Key("bus").Value(edge_info.bus)
-					.Key("time").Value(edge_info.time)
-					.Key("span_count").Value(edge_info.span_count)
-					.EndDict().Build());
+				writer.Key("bus").String(edge_info.bus)
+					.Key("span_count").Int(edge_info.span_count)
+					.Key("time").Double(edge_info.time);
 			}
+			writer.Key("type").String(edge_info.type).EndDict();
+		}
+		writer.EndArray()
+			.Key("request_id").Int(node.AsMap().at("id").AsInt());
+		// Для пустого маршрута время выводится целым нулём
+		if (info.value().empty()) {
+			writer.Key("total_time").Int(0);
+		}
+		else {
+			writer.Key("total_time").Double(total_time);
 		}
-		return json::Builder{}.StartDict()
-			.Key("request_id").Value(node.AsMap().at("id").AsInt())
-			.Key("total_time").Value(total_time)
-			.Key("items").Value(items)
-			.EndDict().Build();
+		writer.EndDict();
 	}
 
-	void RequestHandler::SetCatalogue(transport_catalogue::TransportCatalogue& catalogue) {
-		db_ = catalogue;
+	void RequestHandler::MakeJsonOutputRouteFromPoint(const json::LazyNode& node, json::Writer& writer) {
+		const json::LazyMap request = node.AsMap();
+		geo::Coordinates from;
+		from.lat = request.at("from_latitude").AsDouble();
+		from.lng = request.at("from_longitude").AsDouble();
+		geo::Coordinates to;
+		to.lat = request.at("to_latitude").AsDouble();
+		to.lng = request.at("to_longitude").AsDouble();
+		const int snap_count = request.count("snap_count") != 0 ? std::max(request.at("snap_count").AsInt(), 0) : 3;
+		MakeJsonOutputRoute(node, router_.BuildRouteFromPoint(db_, from, to, snap_count), writer);
+	}
+
+	void RequestHandler::ParseStatRequest(const stat_proto::StatRequest& request, stat_proto::StatResponse& response) {
+		static metrics::Counter& request_counter = metrics::GetCounter("stat.requests");
+		const RequestHistograms& histograms = GetRequestHistograms();
+		request_counter.Add();
+		response.Clear();
+		response.set_request_id(request.id());
+		switch (request.request_case()) {
+		case stat_proto::StatRequest::kBus: {
+			const metrics::ScopedTimer timer(histograms.bus);
+			MakeProtoOutputBus(request.bus(), response);
+			break;
+		}
+		case stat_proto::StatRequest::kStop: {
+			const metrics::ScopedTimer timer(histograms.stop);
+			MakeProtoOutputStop(request.stop(), response);
+			break;
+		}
+		case stat_proto::StatRequest::kRoute: {
+			const metrics::ScopedTimer timer(histograms.route);
+			MakeProtoOutputRoute(request.route(), response);
+			break;
+		}
+		case stat_proto::StatRequest::kMap: {
+			const metrics::ScopedTimer timer(histograms.map);
+			response.mutable_map()->set_map(GetMapSvg());
+			break;
+		}
+		default:
+			response.set_error_message("unknown request");
+			break;
+		}
+	}
+
+	void RequestHandler::MakeProtoOutputBus(const stat_proto::BusRequest& request, stat_proto::StatResponse& response) {
+		const std::optional<domain::Statistics> request_result = GetBusStat(request.name());
+		if (!request_result) {
+			response.set_error_message("not found");
+			return;
+		}
+		stat_proto::BusResponse& bus = *response.mutable_bus();
+		bus.set_curvature(request_result->curvature);
+		bus.set_route_length(request_result->distance);
+		bus.set_stop_count(static_cast<int>(request_result->stops_count));
+		bus.set_unique_stop_count(static_cast<int>(request_result->unique_stops_count));
+	}
+
+	void RequestHandler::MakeProtoOutputStop(const stat_proto::StopRequest& request, stat_proto::StatResponse& response) {
+		const auto request_result = db_.BusesOnStopView(request.name());
+		if (!request_result) {
+			response.set_error_message("not found");
+			return;
+		}
+		stat_proto::StopResponse& stop = *response.mutable_stop();
+		for (std::string_view bus : *request_result) {
+			stop.add_buses(bus.data(), bus.size());
+		}
+	}
+
+	void RequestHandler::MakeProtoOutputRoute(const stat_proto::RouteRequest& request, stat_proto::StatResponse& response) {
+		router_.Prepare(db_);
+		const auto info = router_.BuildRoute(request.from(), request.to());
+		if (!info) {
+			response.set_error_message("not found");
+			return;
+		}
+		stat_proto::RouteResponse& route = *response.mutable_route();
+		double total_time = 0;
+		for (const auto& edge_info : *info) {
+			total_time += edge_info.time;
+			stat_proto::RouteItem& item = *route.add_items();
+			item.set_time(edge_info.time);
+			if (edge_info.type == "Wait") {
+				item.set_type(stat_proto::RouteItem::WAIT);
+				item.set_stop_name(edge_info.stop_name.data(), edge_info.stop_name.size());
+			}
+			else {
+				item.set_type(stat_proto::RouteItem::BUS);
+				item.set_bus(edge_info.bus.data(), edge_info.bus.size());
+				item.set_span_count(edge_info.span_count);
+			}
+		}
+		route.set_total_time(total_time);
 	}
 
 	void RequestHandler::SetRenderer(renderer::MapRenderer& renderer) {
 		renderer_ = renderer;
 	}
+	void RequestHandler::MakeJsonOutputNearestStops(const json::LazyNode& node, json::Writer& writer) {
+		const json::LazyMap request = node.AsMap();
+		geo::Coordinates point;
+		point.lat = request.at("latitude").AsDouble();
+		point.lng = request.at("longitude").AsDouble();
+		const int count = request.count("count") != 0 ? std::max(request.at("count").AsInt(), 0) : 1;
+		const double max_distance = request.count("max_distance") != 0 ? request.at("max_distance").AsDouble() : std::numeric_limits<double>::infinity();
+		writer.StartDict()
+			.Key("request_id").Int(request.at("id").AsInt())
+			.Key("stops").StartArray();
+		for (const auto& [stop, distance] : db_.FindNearestStops(point, count, max_distance)) {
+			writer.StartDict()
+				.Key("distance").Double(distance)
+				.Key("name").String(stop->name)
+				.EndDict();
+		}
+		writer.EndArray().EndDict();
+	}
+
+	void RequestHandler::MakeJsonOutputStopsInBox(const json::LazyNode& node, json::Writer& writer) {
+		const json::LazyMap request = node.AsMap();
+		geo::Coordinates min;
+		min.lat = request.at("min_latitude").AsDouble();
+		min.lng = request.at("min_longitude").AsDouble();
+		geo::Coordinates max;
+		max.lat = request.at("max_latitude").AsDouble();
+		max.lng = request.at("max_longitude").AsDouble();
+		writer.StartDict()
+			.Key("request_id").Int(request.at("id").AsInt())
+			.Key("stops").StartArray();
+		for (const domain::Stop* stop : db_.FindStopsInBox(min, max)) {
+			writer.String(stop->name);
+		}
+		writer.EndArray().EndDict();
+	}
+
 	double RequestHandler::GetBusVelocity() const {
 		return router_.GetBusVelocity();
 	}
 	int RequestHandler::GetBusWaitTime() const {
 		return router_.GetBusWaitTime();
 	}
+	double RequestHandler::GetPedestrianVelocity() const {
+		return router_.GetPedestrianVelocity();
+	}
 
 } //namespace request
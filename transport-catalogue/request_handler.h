@@ -1,11 +1,23 @@
 #pragma once
 #include "json.h"
+#include "json_writer.h"
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include "metrics.h"
+#include <stat_requests.pb.h>
 #include "transport_catalogue.h"
 #include "transport_router.h"
 #include "map_renderer.h"
 
 namespace request_handler {
 
+    // Сводка по пакету запросов: сколько ответов взято готовыми у таких же запросов пакета
+    struct BatchStats {
+        size_t request_count = 0;
+        size_t duplicate_count = 0;
+    };
+
     class RequestHandler {
     public:
         RequestHandler(transport_catalogue::TransportCatalogue& db, renderer::MapRenderer& renderer);
@@ -15,6 +27,8 @@ namespace request_handler {
         const std::set<std::string_view> GetAllBusesNames() const;
         const std::vector<std::string_view> GetBusRoute(const std::string_view bus_name) const;
         const geo::Coordinates GetStopCoordinates(const std::string_view stop_name) const;
+        transport_catalogue::TransportCatalogue::BusesRange GetSortedBuses() const;
+        transport_catalogue::TransportCatalogue::StopsRange GetSortedStopsOnRoutes() const;
         void AddStopToCatalogue(std::string stop_name, double latitude, double longitude);
         void AddStopDistancesToCatalogue(std::string& stop_name, std::vector<std::pair<std::string, int>> stop_to_distance);
         void AddBusToCatalogue(std::string& bus_name, std::vector<std::string>& route, bool is_rounded);
@@ -33,20 +47,79 @@ namespace request_handler {
         void RenderMap(svg::Document& doc);
         void SetBusVelocity(int velocity);
         void SetBusWaitTime(int time);
+        void SetPedestrianVelocity(double velocity);
         double GetBusVelocity() const;
         int GetBusWaitTime() const;
-        void BuildGraph();
-        json::Array ParseStatRequests(const json::Node& node);
-        void SetCatalogue(transport_catalogue::TransportCatalogue& catalogue);
+        double GetPedestrianVelocity() const;
+        // Готовит маршрутизатор заранее. Без этого он строится перед первым пакетом, в котором есть маршруты
+        void PrepareRouter();
+        // Пишет ответ на один запрос; для неизвестного типа запроса ничего не пишет и возвращает false.
+        // Запросы маршрутов требуют подготовленного маршрутизатора
+        bool ParseStatRequest(const json::LazyNode& node, json::Writer& writer);
+        // Отвечает на все запросы пакета и выводит массив ответов в порядке запросов.
+        // При threads > 1 запросы обрабатываются блоками в нескольких потоках.
+        // Одинаковые запросы Bus, Stop и Route вычисляются один раз на пакет
+        BatchStats ParseStatRequests(const json::LazyArray& requests, std::ostream& output, size_t threads);
+        // Пакет, который читается и отвечается блоками
+        class BatchStream;
+        // Ответ на запрос из потока process_requests --format=proto. Маршрутизатор готовится
+        // при первом запросе маршрута, поэтому такие запросы отвечаются в одном потоке
+        void ParseStatRequest(const stat_proto::StatRequest& request, stat_proto::StatResponse& response);
         void SetRenderer(renderer::MapRenderer& renderer);
     private:
+        class DuplicateAnswers;
         transport_catalogue::TransportCatalogue& db_;
         renderer::MapRenderer& renderer_;
         transport_router::TransportRouter router_;
-        json::Node MakeJsonOutputBus(const json::Node& node);
-        json::Node MakeJsonOutputStop(const json::Node& node);
-        json::Node MakeJsonOutputMap(const json::Node& node, svg::Document& map);
-        json::Node MakeJsonOutputRoute(const json::Node& node, std::optional<std::vector<transport_router::EdgeInfo>> info);
+        // Карта зависит только от базы и настроек отрисовки, поэтому рисуется один раз за процесс,
+        // при первом запросе Map. Для ответов JSON она хранится экранированной строкой вместе с кавычками,
+        // а текст SVG как есть — только для ответов proto, и только если пришёл такой запрос
+        std::mutex render_mutex_;
+        std::once_flag map_json_once_;
+        std::string map_json_;
+        std::once_flag map_svg_once_;
+        std::string map_svg_;
+        // Рисует карту в output. Отрисовка меняет проекцию в renderer_, поэтому идёт под render_mutex_
+        void RenderMapTo(std::ostream& output);
+        const std::string& GetMapSvg();
+        void MakeJsonOutputNotFound(const json::LazyNode& node, json::Writer& writer);
+        void MakeJsonOutputBus(const json::LazyNode& node, json::Writer& writer);
+        void MakeJsonOutputStop(const json::LazyNode& node, json::Writer& writer);
+        void MakeJsonOutputMap(const json::LazyNode& node, json::Writer& writer);
+        void MakeJsonOutputRoute(const json::LazyNode& node, const std::optional<std::vector<transport_router::EdgeInfo>>& info, json::Writer& writer);
+        void MakeJsonOutputRouteFromPoint(const json::LazyNode& node, json::Writer& writer);
+        void MakeJsonOutputNearestStops(const json::LazyNode& node, json::Writer& writer);
+        void MakeJsonOutputStopsInBox(const json::LazyNode& node, json::Writer& writer);
+        bool ParseStatRequest(const json::LazyNode& node, json::Writer& writer, DuplicateAnswers& duplicates);
+        void MakeProtoOutputBus(const stat_proto::BusRequest& request, stat_proto::StatResponse& response);
+        void MakeProtoOutputStop(const stat_proto::StopRequest& request, stat_proto::StatResponse& response);
+        void MakeProtoOutputRoute(const stat_proto::RouteRequest& request, stat_proto::StatResponse& response);
+        // Дописывает ответы на requests в открытый массив writer и выводит их в output по мере готовности
+        void AnswerBlock(const json::LazyArray& requests, DuplicateAnswers& duplicates, json::Writer& writer, std::ostream& output, size_t threads);
+        void ParseStatRequestsInParallel(const json::LazyArray& requests, DuplicateAnswers& duplicates, json::Writer& writer, std::ostream& output, size_t threads);
+    };
+
+    /*
+     * Пакет, который читается и отвечается блоками: массив ответов открыт от первого блока до Finish.
+     * Готовые ответы переходят из блока в блок, так что одинаковые запросы, как и в ParseStatRequests,
+     * вычисляются один раз на пакет. Ответы хранятся для следующих блоков в пределах мегабайта;
+     * сверх них ответ хранится, только пока его ждут запросы уже прочитанных блоков
+     */
+    class RequestHandler::BatchStream {
+    public:
+        BatchStream(RequestHandler& handler, std::ostream& output, size_t threads);
+        ~BatchStream();
+        // Отвечает на очередной блок запросов и сразу выводит ответы
+        void Answer(const json::LazyArray& requests);
+        // Закрывает массив ответов и возвращает сводку по всему пакету
+        BatchStats Finish();
+    private:
+        RequestHandler& handler_;
+        std::ostream& output_;
+        size_t threads_;
+        json::Writer writer_;
+        std::unique_ptr<DuplicateAnswers> duplicates_;
+        metrics::ScopedTimer timer_;
     };
 
 } // namespace request
@@ -29,6 +29,18 @@ namespace graph {
 
         std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
 
+        struct MultiRouteInfo {
+            VertexId from;
+            VertexId to;
+            Weight weight;
+            std::vector<EdgeId> edges;
+        };
+
+        // Источники и цели идут с начальным весом (например, временем пешего пути до вершины).
+        // Лучшая пара выбирается по заранее посчитанной таблице, и восстанавливается только её маршрут
+        std::optional<MultiRouteInfo> BuildRoute(const std::vector<std::pair<VertexId, Weight>>& sources,
+            const std::vector<std::pair<VertexId, Weight>>& targets) const;
+
     private:
         struct RouteInternalData {
             Weight weight;
@@ -114,4 +126,28 @@ namespace graph {
         return RouteInfo{ weight, std::move(edges) };
     }
 
+    template <typename Weight>
+    std::optional<typename Router<Weight>::MultiRouteInfo> Router<Weight>::BuildRoute(
+        const std::vector<std::pair<VertexId, Weight>>& sources,
+        const std::vector<std::pair<VertexId, Weight>>& targets) const {
+        std::optional<MultiRouteInfo> best;
+        for (const auto& [from, from_weight] : sources) {
+            const auto& routes_from = routes_internal_data_.at(from);
+            for (const auto& [to, to_weight] : targets) {
+                const auto& route_internal_data = routes_from.at(to);
+                if (!route_internal_data) {
+                    continue;
+                }
+                const Weight weight = from_weight + route_internal_data->weight + to_weight;
+                if (!best || weight < best->weight) {
+                    best = MultiRouteInfo{ from, to, weight, {} };
+                }
+            }
+        }
+        if (best) {
+            best->edges = std::move(BuildRoute(best->from, best->to)->edges);
+        }
+        return best;
+    }
+
 }  // namespace graph
\ No newline at end of file
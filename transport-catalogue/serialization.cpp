@@ -1,43 +1,50 @@
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/util/delimited_message_util.h>
 #include <map_renderer.pb.h>
 #include <svg.pb.h>
 #include <fstream>
 #include <sstream>
+#include <stdexcept>
 #include "serialization.h"
+#include "metrics.h"
 
-void Serialization::SaveStops(transport_catalogue::TransportCatalogue& tc_) {
-    for (const auto& stop_name : tc_.GetAllStopsNames()) {
-        auto stop = tc_.GetStopByName(stop_name);
+void Serialization::SaveStops(const transport_catalogue::TransportCatalogue& tc_) {
+    std::string& names = *catalogue_.mutable_names();
+    for (const domain::Stop& stop : tc_.GetStops()) {
         transport::Stop add_stop;
-        add_stop.set_name(stop.name);
+        add_stop.set_name_offset(static_cast<uint32_t>(names.size()));
+        add_stop.set_name_size(static_cast<uint32_t>(stop.name.size()));
+        names.append(stop.name);
         add_stop.mutable_coordinates()->set_lat(stop.coordinates.lat);
         add_stop.mutable_coordinates()->set_lng(stop.coordinates.lng);
         *catalogue_.add_stops() = std::move(add_stop);
     }
 }
 
-void Serialization::SaveStopsDistances(transport_catalogue::TransportCatalogue& tc_) {
+void Serialization::SaveStopsDistances(const transport_catalogue::TransportCatalogue& tc_) {
     int i = 0;
-    for (const auto& [stop_to_stop, distance] : tc_.GetAllStopToStopDistances()) {
+    for (const auto& [stop_to_stop, distance] : tc_.GetStopToStopDistances()) {
         catalogue_.mutable_distances()->add_distance();
-        catalogue_.mutable_distances()->mutable_distance(i)->set_from_stop(std::string(stop_to_stop.first));
-        catalogue_.mutable_distances()->mutable_distance(i)->set_to_stop(std::string(stop_to_stop.second));
+        catalogue_.mutable_distances()->mutable_distance(i)->set_from_stop_id(static_cast<uint32_t>(stop_to_stop.first->id));
+        catalogue_.mutable_distances()->mutable_distance(i)->set_to_stop_id(static_cast<uint32_t>(stop_to_stop.second->id));
         catalogue_.mutable_distances()->mutable_distance(i)->set_distance(distance);
         ++i;
     }
 }
 
-void Serialization::SaveBuses(transport_catalogue::TransportCatalogue& tc_) {
+void Serialization::SaveBuses(const transport_catalogue::TransportCatalogue& tc_) {
+    std::string& names = *catalogue_.mutable_names();
     int i = 0;
-    for (const auto& [name, bus] : tc_.GetAllBuses()) {
+    for (const domain::Bus& bus : tc_.GetBuses()) {
         catalogue_.add_buses();
-        //transport::Bus add_bus;
-        catalogue_.mutable_buses(i)->set_name(bus->name);
-        catalogue_.mutable_buses(i)->set_is_rounded(bus->is_rounded);
-        for (const auto& stop : bus->route) {
-            catalogue_.mutable_buses(i)->add_route(stop->name);
+        catalogue_.mutable_buses(i)->set_name_offset(static_cast<uint32_t>(names.size()));
+        catalogue_.mutable_buses(i)->set_name_size(static_cast<uint32_t>(bus.name.size()));
+        names.append(bus.name);
+        catalogue_.mutable_buses(i)->set_is_rounded(bus.is_rounded);
+        for (const auto& stop : bus.route) {
+            catalogue_.mutable_buses(i)->add_route(static_cast<uint32_t>(stop->id));
         }
         ++i;
-        //*catalogue_.add_buses() = std::move(add_bus);
     }
 }
 
@@ -106,50 +113,80 @@ void Serialization::SaveRenderSettings(renderer::MapRenderer::MapSettings& map_s
     }
 }
 
-void Serialization::SaveRouterSettings(std::pair<int, double> router_info) {
-    catalogue_.mutable_router_info()->set_bus_wait_time(router_info.first);
-    catalogue_.mutable_router_info()->set_bus_velocity(router_info.second);
+void Serialization::SaveRouterSettings(const transport_router::RoutingSettings& routing_settings) {
+    catalogue_.mutable_router_info()->set_bus_wait_time(routing_settings.bus_wait_time);
+    catalogue_.mutable_router_info()->set_bus_velocity(routing_settings.bus_velocity);
+    catalogue_.mutable_router_info()->set_pedestrian_velocity(routing_settings.pedestrian_velocity);
 }
 
-void Serialization::CreateBase(transport_catalogue::TransportCatalogue& tc_, renderer::MapRenderer::MapSettings& map_settings, std::pair<int, double>& router_info) {
+void Serialization::SaveNameIndex(const domain::FrozenNameIndex& index, transport::NameIndex& index_proto) {
+    for (int32_t displacement : index.GetDisplacements()) {
+        index_proto.add_displacements(displacement);
+    }
+    for (uint32_t slot : index.GetSlots()) {
+        index_proto.add_slots(slot);
+    }
+}
+
+void Serialization::SaveStopsGrid(const geo::GridIndex& grid) {
+    transport::StopsGrid& grid_proto = *catalogue_.mutable_stops_grid();
+    const geo::GridIndex::Layout& layout = grid.GetLayout();
+    grid_proto.set_min_lat(layout.min_lat);
+    grid_proto.set_min_lng(layout.min_lng);
+    grid_proto.set_cell_lat(layout.cell_lat);
+    grid_proto.set_cell_lng(layout.cell_lng);
+    grid_proto.set_rows(layout.rows);
+    grid_proto.set_cols(layout.cols);
+    for (uint32_t cell_start : grid.GetCellStarts()) {
+        grid_proto.add_cell_starts(cell_start);
+    }
+    for (uint32_t stop_id : grid.GetIds()) {
+        grid_proto.add_stop_ids(stop_id);
+    }
+}
+
+void Serialization::CreateBase(const transport_catalogue::TransportCatalogue& tc_, renderer::MapRenderer::MapSettings& map_settings, const transport_router::RoutingSettings& routing_settings) {
+    static metrics::Histogram& histogram = metrics::GetHistogram("base.save");
+    const metrics::ScopedTimer timer(histogram);
     std::ofstream out_file(file_name, std::ios::binary);
     SaveStops(tc_);
     SaveBuses(tc_);
     SaveStopsDistances(tc_);
     SaveRenderSettings(map_settings);
-    SaveRouterSettings(router_info);
+    SaveRouterSettings(routing_settings);
+    SaveNameIndex(tc_.GetStopsIndex(), *catalogue_.mutable_stops_index());
+    SaveNameIndex(tc_.GetBusesIndex(), *catalogue_.mutable_buses_index());
+    SaveStopsGrid(tc_.GetStopsGrid());
     catalogue_.SerializeToOstream(&out_file);
 }
 
 void Serialization::LoadStops(transport_catalogue::TransportCatalogue& tc_) {
     for (int i = 0; i < catalogue_.stops_size(); ++i) {
-        auto stop = catalogue_.stops(i);
-        std::string name = stop.name();
+        const transport::Stop& stop = catalogue_.stops(i);
         double lat = stop.coordinates().lat();
         double lng = stop.coordinates().lng();
-        tc_.AddStop(name, lat, lng);
+        tc_.AddStop(names_.substr(stop.name_offset(), stop.name_size()), lat, lng);
     }
 }
 
 void Serialization::LoadStopsDistances(transport_catalogue::TransportCatalogue& tc_) {
+    const auto& stops = tc_.GetStops();
     for (int i = 0; i < catalogue_.distances().distance_size(); ++i) {
-        std::string from = catalogue_.distances().distance(i).from_stop();
-        std::string to = catalogue_.distances().distance(i).to_stop();
-        int distance = catalogue_.distances().distance(i).distance();
-        tc_.AddStopToStopDistance(from, to, distance);
+        const transport::StopDistance& distance = catalogue_.distances().distance(i);
+        tc_.AddStopToStopDistance(&stops.at(distance.from_stop_id()), &stops.at(distance.to_stop_id()), distance.distance());
     }
 }
 
 void Serialization::LoadBuses(transport_catalogue::TransportCatalogue& tc_) {
+    const auto& stops = tc_.GetStops();
+    std::vector<const domain::Stop*> route;
     for (int i = 0; i < catalogue_.buses_size(); ++i) {
-        auto bus = catalogue_.buses(i);
-        std::string name = bus.name();
-        bool is_rounded = bus.is_rounded();
-        std::vector<std::string> route;
-        for (auto stop : bus.route()) {
-            route.push_back(stop);
+        const transport::Bus& bus = catalogue_.buses(i);
+        route.clear();
+        for (uint32_t stop_id : bus.route()) {
+            route.push_back(&stops.at(stop_id));
         }
-        tc_.AddBus(name, route, is_rounded);
+        tc_.AddBus(names_.substr(bus.name_offset(), bus.name_size()), route, bus.is_rounded());
     }
 }
 
@@ -196,38 +233,135 @@ void Serialization::LoadRenderSettings(renderer::MapRenderer& renderer_) {
     }
 }
 
-std::pair<int, double> Serialization::LoadRouterSettings() {
-    return std::make_pair(catalogue_.router_info().bus_wait_time(), catalogue_.router_info().bus_velocity());
+transport_router::RoutingSettings Serialization::LoadRouterSettings() {
+    transport_router::RoutingSettings routing_settings;
+    routing_settings.bus_wait_time = catalogue_.router_info().bus_wait_time();
+    routing_settings.bus_velocity = catalogue_.router_info().bus_velocity();
+    // В базах, собранных до появления пешеходной скорости, поле пустое — остаётся значение по умолчанию
+    if (catalogue_.router_info().pedestrian_velocity() > 0) {
+        routing_settings.pedestrian_velocity = catalogue_.router_info().pedestrian_velocity();
+    }
+    return routing_settings;
+}
+
+domain::FrozenNameIndex Serialization::LoadNameIndex(const transport::NameIndex& index_proto) {
+    return domain::FrozenNameIndex(
+        std::vector<int32_t>(index_proto.displacements().begin(), index_proto.displacements().end()),
+        std::vector<uint32_t>(index_proto.slots().begin(), index_proto.slots().end()));
 }
 
-std::pair<int, double> Serialization::LoadBase(transport_catalogue::TransportCatalogue& tc_, renderer::MapRenderer& renderer_) {
+void Serialization::LoadStopsGrid(transport_catalogue::TransportCatalogue& tc_) {
+    const transport::StopsGrid& grid_proto = catalogue_.stops_grid();
+    geo::GridIndex::Layout layout;
+    layout.min_lat = grid_proto.min_lat();
+    layout.min_lng = grid_proto.min_lng();
+    layout.cell_lat = grid_proto.cell_lat();
+    layout.cell_lng = grid_proto.cell_lng();
+    layout.rows = grid_proto.rows();
+    layout.cols = grid_proto.cols();
+    geo::GridIndex grid(layout,
+        std::vector<uint32_t>(grid_proto.cell_starts().begin(), grid_proto.cell_starts().end()),
+        std::vector<uint32_t>(grid_proto.stop_ids().begin(), grid_proto.stop_ids().end()));
+    // Номера в сетке — номера остановок, и в сетке лежит каждая остановка
+    if (grid_proto.stop_ids_size() != catalogue_.stops_size() || !grid.IsValid(static_cast<size_t>(catalogue_.stops_size()))) {
+        // В базе нет подходящей сетки — строим её по загруженным остановкам
+        tc_.BuildStopsGrid();
+        return;
+    }
+    tc_.SetStopsGrid(std::move(grid));
+}
+
+std::optional<transport_router::RoutingSettings> Serialization::LoadBase(transport_catalogue::TransportCatalogue& tc_, renderer::MapRenderer& renderer_) {
+    static metrics::Histogram& histogram = metrics::GetHistogram("base.load");
+    const metrics::ScopedTimer timer(histogram);
     std::ifstream in_file(file_name, std::ios::binary);
-    catalogue_.ParseFromIstream(&in_file);
+    if (!in_file || !catalogue_.ParseFromIstream(&in_file)) {
+        return std::nullopt;
+    }
+    // Блок имён переходит в арену каталога целиком, остановки и маршруты ссылаются прямо на него
+    names_ = tc_.AdoptNames(std::move(*catalogue_.mutable_names()));
+    // Сохранённые индексы имён используются как есть, имена не вставляются в хеш-таблицы заново.
+    // Если индекс в базе не сходится с её содержимым, имена ищутся через обычные хеш-таблицы
+    if (catalogue_.stops_index().slots_size() == catalogue_.stops_size() && catalogue_.buses_index().slots_size() == catalogue_.buses_size()) {
+        domain::FrozenNameIndex stops_index = LoadNameIndex(catalogue_.stops_index());
+        domain::FrozenNameIndex buses_index = LoadNameIndex(catalogue_.buses_index());
+        if (stops_index.IsValid() && buses_index.IsValid()) {
+            tc_.SetNameIndexes(std::move(stops_index), std::move(buses_index));
+        }
+    }
     LoadStops(tc_);
+    LoadStopsGrid(tc_);
     LoadStopsDistances(tc_);
     LoadBuses(tc_);
+    tc_.SortByNames();
     LoadRenderSettings(renderer_);
     return LoadRouterSettings();
 }
 
 void Serialization::MakeBase(std::istream& input) {
     JsonReader reader;
-    auto result = reader.ParseInput(input);
-    file_name = result.first;
-    auto tc_ = result.second;
+    file_name = reader.ParseInput(input);
     auto map_settings = reader.GetMapSettings();
-    CreateBase(tc_, map_settings, reader.GetBusRouterInfo());
+    CreateBase(reader.GetCatalogue(), map_settings, reader.GetRoutingSettings());
+}
+
+request_handler::BatchStats Serialization::ProcessRequests(std::istream& input, size_t threads) {
+    JsonReader reader;
+    // Вход разбирается один раз: база загружается, как только из него станет известно имя файла
+    return reader.CalculateOutput(input, [this, &reader](const std::string& base_file_name) {
+        // Без базы любой запрос получил бы ответ «не найдено», поэтому до ответов дело не доходит
+        if (!Load(base_file_name, reader)) {
+            throw std::runtime_error("Cannot load base file: " + base_file_name);
+        }
+        }, threads);
 }
 
-void Serialization::ProcessRequests(std::istream& input) {
+request_handler::BatchStats Serialization::ProcessProtoRequests(std::istream& input, std::ostream& output) {
+    google::protobuf::io::IstreamInputStream raw_input(&input);
+    stat_proto::StatStreamHeader header;
+    bool is_clean_eof = false;
+    if (!google::protobuf::util::ParseDelimitedFromZeroCopyStream(&header, &raw_input, &is_clean_eof)) {
+        // Пустой вход — пустой поток ответов, а испорченный заголовок — ошибка
+        if (is_clean_eof) {
+            return {};
+        }
+        throw std::runtime_error("Cannot parse the stat request stream header");
+    }
     JsonReader reader;
-    auto result = reader.ParseStatInput(input);
-    file_name = result.first;
+    if (!Load(header.file(), reader)) {
+        throw std::runtime_error("Cannot load base file: " + header.file());
+    }
+    request_handler::RequestHandler& handler = reader.GetHandler();
+    request_handler::BatchStats stats;
+    // Сообщения переиспользуются от запроса к запросу вместе с выделенной под них памятью
+    stat_proto::StatRequest request;
+    stat_proto::StatResponse response;
+    {
+        google::protobuf::io::OstreamOutputStream raw_output(&output);
+        while (google::protobuf::util::ParseDelimitedFromZeroCopyStream(&request, &raw_input, &is_clean_eof)) {
+            handler.ParseStatRequest(request, response);
+            google::protobuf::util::SerializeDelimitedToZeroCopyStream(response, &raw_output);
+            ++stats.request_count;
+        }
+    }
+    output.flush();
+    // Цикл заканчивается и на обрезанном или испорченном сообщении: ответы на предыдущие запросы уже выведены
+    if (!is_clean_eof) {
+        throw std::runtime_error("Cannot parse stat request #" + std::to_string(stats.request_count + 1) + ": the stream is truncated or malformed");
+    }
+    return stats;
+}
+
+bool Serialization::Load(const std::string& base_file_name, JsonReader& reader) {
+    file_name = base_file_name;
     transport_catalogue::TransportCatalogue tc_;
     renderer::MapRenderer renderer_;
-    std::pair<int, double> router_info = LoadBase(tc_, renderer_);
-    reader.SetCatalogue(tc_);
+    std::optional<transport_router::RoutingSettings> routing_settings = LoadBase(tc_, renderer_);
+    if (!routing_settings) {
+        return false;
+    }
+    reader.SetCatalogue(std::move(tc_));
     reader.SetRenderer(renderer_);
-    reader.SetBusRouterInfo(router_info);
-    reader.CalculateOutput(result.second);
+    reader.SetRoutingSettings(*routing_settings);
+    return true;
 }
@@ -6,23 +6,36 @@
 class Serialization {
 public:
     void MakeBase(std::istream& input);
-    void ProcessRequests(std::istream& input);
+    // Бросает std::runtime_error, если базу не удалось загрузить; ответы при этом не выводятся
+    request_handler::BatchStats ProcessRequests(std::istream& input, size_t threads = 1);
+    // То же для двоичного потока из stat_requests.proto: заголовок с именем файла базы и запросы
+    // с префиксами длины на входе, ответы с префиксами длины на выходе. Если заголовок или запрос
+    // не разбираются (в том числе обрезаны), бросает std::runtime_error после ответов на предыдущие запросы
+    request_handler::BatchStats ProcessProtoRequests(std::istream& input, std::ostream& output);
+    // Загружает базу из файла в reader: каталог, настройки отрисовки и маршрутизации.
+    // Если файл не открылся или не разобрался, возвращает false и не меняет reader
+    bool Load(const std::string& base_file_name, JsonReader& reader);
 
 private:
     mutable transport::TransportCatalogue catalogue_;
     std::string file_name;
+    std::string_view names_;
 
-    void SaveStops(transport_catalogue::TransportCatalogue& tc_);
-    void SaveStopsDistances(transport_catalogue::TransportCatalogue& tc_);
-    void SaveBuses(transport_catalogue::TransportCatalogue& tc_);
+    void SaveStops(const transport_catalogue::TransportCatalogue& tc_);
+    void SaveStopsDistances(const transport_catalogue::TransportCatalogue& tc_);
+    void SaveBuses(const transport_catalogue::TransportCatalogue& tc_);
     void SaveRenderSettings(renderer::MapRenderer::MapSettings& map_settings);
-    void SaveRouterSettings(std::pair<int, double> router_info);
-    void CreateBase(transport_catalogue::TransportCatalogue& tc_, renderer::MapRenderer::MapSettings& map_settings, std::pair<int, double>& router_info);
+    void SaveRouterSettings(const transport_router::RoutingSettings& routing_settings);
+    void SaveNameIndex(const domain::FrozenNameIndex& index, transport::NameIndex& index_proto);
+    void SaveStopsGrid(const geo::GridIndex& grid);
+    void CreateBase(const transport_catalogue::TransportCatalogue& tc_, renderer::MapRenderer::MapSettings& map_settings, const transport_router::RoutingSettings& routing_settings);
 
     void LoadStops(transport_catalogue::TransportCatalogue& tc_);
     void LoadStopsDistances(transport_catalogue::TransportCatalogue& tc_);
     void LoadBuses(transport_catalogue::TransportCatalogue& tc_);
     void LoadRenderSettings(renderer::MapRenderer& renderer_);
-    std::pair<int, double> LoadRouterSettings();
-    std::pair<int, double> LoadBase(transport_catalogue::TransportCatalogue& tc_, renderer::MapRenderer& renderer_);
+    transport_router::RoutingSettings LoadRouterSettings();
+    domain::FrozenNameIndex LoadNameIndex(const transport::NameIndex& index_proto);
+    void LoadStopsGrid(transport_catalogue::TransportCatalogue& tc_);
+    std::optional<transport_router::RoutingSettings> LoadBase(transport_catalogue::TransportCatalogue& tc_, renderer::MapRenderer& renderer_);
 };
@@ -0,0 +1,300 @@
+#include "server.h"
+#include <atomic>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include "json_writer.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SERVER_POSIX
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace server {
+
+    namespace {
+
+        // Сигнал только отмечает, что базу нужно перечитать; саму загрузку делает поток наблюдения.
+        // Атомарный флаг без блокировок можно менять из обработчика сигнала
+        std::atomic<bool> reload_requested = false;
+
+#ifdef SERVER_POSIX
+        void RequestReload(int) {
+            reload_requested = true;
+        }
+#endif
+
+        // На системах без SIGHUP база перечитывается только по изменению файла
+        void InstallReloadSignal() {
+#ifdef SERVER_POSIX
+            // SA_RESTART обязателен: иначе сигнал прервёт чтение пакета, и поток ввода закончится ошибкой
+            struct sigaction action {};
+            action.sa_handler = RequestReload;
+            sigemptyset(&action.sa_mask);
+            action.sa_flags = SA_RESTART;
+            sigaction(SIGHUP, &action, nullptr);
+#endif
+        }
+
+#ifdef SERVER_POSIX
+        // Буфер потока поверх подключённого сокета: читает и пишет блоками, а не по символу
+        class SocketBuffer : public std::streambuf {
+        public:
+            explicit SocketBuffer(int socket)
+                : socket_(socket) {
+                setg(input_, input_, input_);
+                setp(output_, output_ + sizeof(output_));
+            }
+
+            ~SocketBuffer() override {
+                Drain();
+            }
+
+        protected:
+            int_type underflow() override {
+                ssize_t count = 0;
+                do {
+                    count = ::read(socket_, input_, sizeof(input_));
+                } while (count < 0 && errno == EINTR);
+                if (count <= 0) {
+                    return traits_type::eof();
+                }
+                setg(input_, input_, input_ + count);
+                return traits_type::to_int_type(*gptr());
+            }
+
+            int_type overflow(int_type c) override {
+                if (!Drain()) {
+                    return traits_type::eof();
+                }
+                if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                    *pptr() = traits_type::to_char_type(c);
+                    pbump(1);
+                }
+                return traits_type::not_eof(c);
+            }
+
+            int sync() override {
+                return Drain() ? 0 : -1;
+            }
+
+        private:
+            static constexpr size_t BUFFER_SIZE = 64 * 1024;
+            int socket_;
+            char input_[BUFFER_SIZE];
+            char output_[BUFFER_SIZE];
+
+            bool Drain() {
+                const char* data = pbase();
+                while (data != pptr()) {
+                    const ssize_t count = ::write(socket_, data, pptr() - data);
+                    if (count < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        setp(output_, output_ + sizeof(output_));
+                        return false;
+                    }
+                    data += count;
+                }
+                setp(output_, output_ + sizeof(output_));
+                return true;
+            }
+        };
+
+        // Закрывает дескриптор при выходе из области видимости
+        class FileDescriptor {
+        public:
+            explicit FileDescriptor(int descriptor)
+                : descriptor_(descriptor) {
+            }
+
+            FileDescriptor(const FileDescriptor&) = delete;
+            FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+            ~FileDescriptor() {
+                if (descriptor_ >= 0) {
+                    ::close(descriptor_);
+                }
+            }
+
+            int Get() const {
+                return descriptor_;
+            }
+
+        private:
+            int descriptor_;
+        };
+
+        std::system_error MakeSocketError(const char* what) {
+            return std::system_error(errno, std::generic_category(), what);
+        }
+#endif
+
+    } // namespace
+
+    Snapshot::Snapshot(const std::string& base_file_name) {
+        Serialization serialization;
+        if (!serialization.Load(base_file_name, reader_)) {
+            throw std::runtime_error("Cannot load base file: " + base_file_name);
+        }
+        reader_.PrepareRouter();
+    }
+
+    void Snapshot::AnswerBatch(std::string batch, std::ostream& output, size_t threads) {
+        reader_.AnswerBatch(std::move(batch), output, threads);
+    }
+
+    bool Server::BaseStamp::operator==(const BaseStamp& other) const {
+        return time == other.time && size == other.size;
+    }
+
+    bool Server::BaseStamp::operator!=(const BaseStamp& other) const {
+        return !(*this == other);
+    }
+
+    Server::Server(const std::string& base_file_name, size_t threads)
+        : base_file_name_(base_file_name),
+        threads_(threads) {
+        // Отметка снимается до загрузки, чтобы не пропустить запись, случившуюся во время неё
+        const std::optional<BaseStamp> stamp = GetBaseStamp();
+        snapshot_ = std::make_shared<Snapshot>(base_file_name_);
+        InstallReloadSignal();
+        watcher_ = std::thread([this, stamp]() {
+            WatchBase(stamp);
+        });
+    }
+
+    Server::~Server() {
+        {
+            std::lock_guard<std::mutex> lock(watch_mutex_);
+            is_stopping_ = true;
+        }
+        watch_stopped_.notify_one();
+        watcher_.join();
+    }
+
+    void Server::ServeStream(std::istream& input, std::ostream& output) {
+        std::string batch;
+        while (std::getline(input, batch)) {
+            if (batch.find_first_not_of(" \t\r") == std::string::npos) {
+                continue;
+            }
+            AnswerBatch(std::move(batch), output);
+            output << '\n';
+            output.flush();
+        }
+    }
+
+    void Server::AnswerBatch(std::string batch, std::ostream& output) {
+        // Ответы копятся в памяти, чтобы ошибка в середине пакета не оставила в выводе половину массива
+        std::stringstream answers;
+        try {
+            // Снимок удерживается до конца пакета, даже если тем временем его подменят новым
+            const std::shared_ptr<Snapshot> snapshot = std::atomic_load(&snapshot_);
+            snapshot->AnswerBatch(std::move(batch), answers, threads_);
+        }
+        catch (const std::exception& error) {
+            json::Writer writer;
+            writer.StartDict().Key("error_message").String(error.what()).EndDict();
+            writer.Flush(output);
+            return;
+        }
+        output << answers.rdbuf();
+    }
+
+    std::optional<Server::BaseStamp> Server::GetBaseStamp() const {
+        std::error_code error;
+        const std::filesystem::file_time_type time = std::filesystem::last_write_time(base_file_name_, error);
+        if (error) {
+            return std::nullopt;
+        }
+        const std::uintmax_t size = std::filesystem::file_size(base_file_name_, error);
+        if (error) {
+            return std::nullopt;
+        }
+        return BaseStamp{ time, size };
+    }
+
+    void Server::WatchBase(std::optional<BaseStamp> loaded) {
+        static constexpr std::chrono::milliseconds POLL_INTERVAL(500);
+        std::optional<BaseStamp> candidate = loaded;
+        std::unique_lock<std::mutex> lock(watch_mutex_);
+        while (!watch_stopped_.wait_for(lock, POLL_INTERVAL, [this]() { return is_stopping_; })) {
+            const std::optional<BaseStamp> stamp = GetBaseStamp();
+            const bool is_requested = reload_requested.exchange(false);
+            // Изменённый файл перечитывается, только когда он не менялся целый период опроса,
+            // чтобы не загрузить базу, которую ещё дописывают
+            const bool is_settled = stamp && stamp != loaded && stamp == candidate;
+            candidate = stamp;
+            if (!is_requested && !is_settled) {
+                continue;
+            }
+            loaded = stamp;
+            lock.unlock();
+            Reload();
+            lock.lock();
+        }
+    }
+
+    void Server::Reload() {
+        // Новый снимок собирается целиком в этом потоке, пакеты тем временем отвечаются по старому
+        std::shared_ptr<Snapshot> snapshot;
+        try {
+            snapshot = std::make_shared<Snapshot>(base_file_name_);
+        }
+        catch (const std::exception& error) {
+            std::cerr << "Base reload failed, the previous base stays in use: " << error.what() << '\n';
+            return;
+        }
+        std::atomic_store(&snapshot_, std::move(snapshot));
+        std::cerr << "Base reloaded: " << base_file_name_ << '\n';
+    }
+
+    void Server::ServeSocket(const std::string& socket_path) {
+#ifdef SERVER_POSIX
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(address.sun_path)) {
+            throw std::invalid_argument("Socket path is too long: " + socket_path);
+        }
+        std::memcpy(address.sun_path, socket_path.data(), socket_path.size());
+        // Клиент, закрывший подключение раньше времени, не должен завершать весь процесс
+        std::signal(SIGPIPE, SIG_IGN);
+
+        const FileDescriptor listener(::socket(AF_UNIX, SOCK_STREAM, 0));
+        if (listener.Get() < 0) {
+            throw MakeSocketError("socket");
+        }
+        ::unlink(socket_path.c_str());
+        if (::bind(listener.Get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+            throw MakeSocketError("bind");
+        }
+        if (::listen(listener.Get(), SOMAXCONN) < 0) {
+            throw MakeSocketError("listen");
+        }
+        while (true) {
+            const FileDescriptor client(::accept(listener.Get(), nullptr, nullptr));
+            if (client.Get() < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                throw MakeSocketError("accept");
+            }
+            SocketBuffer buffer(client.Get());
+            std::istream input(&buffer);
+            std::ostream output(&buffer);
+            ServeStream(input, output);
+        }
+#else
+        throw std::runtime_error("Unix domain sockets are not supported on this platform: " + socket_path);
+#endif
+    }
+
+} // namespace server
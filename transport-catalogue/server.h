@@ -0,0 +1,74 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include "serialization.h"
+
+namespace server {
+
+    /*
+     * Всё, что нужно для ответов по одной версии базы: каталог, настройки отрисовки и
+     * подготовленный маршрутизатор. После создания снимок меняется только в кеше карты,
+     * а тот заполняется потокобезопасно, поэтому снимком можно пользоваться из нескольких потоков
+     */
+    class Snapshot {
+    public:
+        // Бросает std::runtime_error, если файл базы не удалось прочитать
+        explicit Snapshot(const std::string& base_file_name);
+        void AnswerBatch(std::string batch, std::ostream& output, size_t threads);
+    private:
+        JsonReader reader_;
+    };
+
+    /*
+     * Долгоживущий режим ответов на запросы. База загружается и маршрутизатор готовится один раз
+     * при создании, после чего на каждый пакет уходит только разбор запросов и запись ответов.
+     * Пакет — документ JSON в одну строку с разделом stat_requests, ответ на него — массив
+     * ответов в одну строку. Если пакет разобрать не удалось, вместо массива выводится
+     * словарь с error_message, и обслуживание продолжается.
+     *
+     * Фоновый поток следит за файлом базы и по его изменению или по сигналу SIGHUP собирает
+     * новый снимок, а затем атомарно подменяет им текущий. Пакет, начатый до подмены,
+     * дорабатывает со старым снимком: тот освобождается, когда его отпустит последний пакет
+     */
+    class Server {
+    public:
+        Server(const std::string& base_file_name, size_t threads);
+        ~Server();
+        // Отвечает на пакеты из input, пока он не закончится
+        void ServeStream(std::istream& input, std::ostream& output);
+        // Принимает подключения к сокету Unix по одному и обслуживает каждое как поток пакетов.
+        // Возвращается только при ошибке сокета; на системах без сокетов Unix бросает исключение
+        void ServeSocket(const std::string& socket_path);
+    private:
+        // Время изменения и размер файла базы: по их смене видно, что базу перезаписали
+        struct BaseStamp {
+            std::filesystem::file_time_type time;
+            std::uintmax_t size = 0;
+
+            bool operator==(const BaseStamp& other) const;
+            bool operator!=(const BaseStamp& other) const;
+        };
+
+        std::string base_file_name_;
+        size_t threads_;
+        // Читается и подменяется только через std::atomic_load и std::atomic_store
+        std::shared_ptr<Snapshot> snapshot_;
+        std::mutex watch_mutex_;
+        std::condition_variable watch_stopped_;
+        bool is_stopping_ = false;
+        std::thread watcher_;
+
+        void AnswerBatch(std::string batch, std::ostream& output);
+        std::optional<BaseStamp> GetBaseStamp() const;
+        void WatchBase(std::optional<BaseStamp> loaded);
+        void Reload();
+    };
+
+} // namespace server
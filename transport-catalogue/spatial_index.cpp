@@ -0,0 +1,118 @@
+#define _USE_MATH_DEFINES
+#include "spatial_index.h"
+
+namespace geo {
+
+    namespace {
+        const double METERS_PER_DEGREE = 6371000 * M_PI / 180.;
+        // В среднем столько точек приходится на одну ячейку сетки
+        const double POINTS_PER_CELL = 2.0;
+    }
+
+    GridIndex::GridIndex(Layout layout, std::vector<uint32_t> cell_starts, std::vector<uint32_t> ids)
+        : layout_(layout),
+        cell_starts_(std::move(cell_starts)),
+        ids_(std::move(ids))
+    {
+    }
+
+    GridIndex GridIndex::Build(const std::vector<std::pair<uint32_t, Coordinates>>& points) {
+        if (points.empty()) {
+            return {};
+        }
+        const auto [bottom_it, top_it] = std::minmax_element(points.begin(), points.end(),
+            [](const auto& lhs, const auto& rhs) { return lhs.second.lat < rhs.second.lat; });
+        const auto [left_it, right_it] = std::minmax_element(points.begin(), points.end(),
+            [](const auto& lhs, const auto& rhs) { return lhs.second.lng < rhs.second.lng; });
+
+        Layout layout;
+        layout.min_lat = bottom_it->second.lat;
+        layout.min_lng = left_it->second.lng;
+        const double lat_span = top_it->second.lat - layout.min_lat;
+        const double lng_span = right_it->second.lng - layout.min_lng;
+
+        // Подбираем почти квадратные в метрах ячейки
+        const double mid_lat = (layout.min_lat + top_it->second.lat) / 2;
+        const double height = std::max(lat_span * METERS_PER_DEGREE, 1.0);
+        const double width = std::max(lng_span * METERS_PER_DEGREE * std::cos(mid_lat * M_PI / 180.), 1.0);
+        const double cells_count = std::max(1.0, points.size() / POINTS_PER_CELL);
+        const double cell_side = std::sqrt(height * width / cells_count);
+        layout.rows = lat_span > 0 ? static_cast<uint32_t>(std::clamp(std::ceil(height / cell_side), 1.0, cells_count)) : 1;
+        layout.cols = lng_span > 0 ? static_cast<uint32_t>(std::clamp(std::ceil(width / cell_side), 1.0, cells_count)) : 1;
+        // Небольшой запас, чтобы крайние точки попадали внутрь последней ячейки
+        layout.cell_lat = lat_span > 0 ? lat_span * (1 + 1e-9) / layout.rows : 1.0;
+        layout.cell_lng = lng_span > 0 ? lng_span * (1 + 1e-9) / layout.cols : 1.0;
+
+        GridIndex result;
+        result.layout_ = layout;
+        const size_t cells = static_cast<size_t>(layout.rows) * layout.cols;
+        std::vector<size_t> point_cells(points.size());
+        result.cell_starts_.assign(cells + 1, 0);
+        for (size_t i = 0; i < points.size(); ++i) {
+            point_cells[i] = static_cast<size_t>(result.RowOf(points[i].second.lat)) * layout.cols + result.ColOf(points[i].second.lng);
+            ++result.cell_starts_[point_cells[i] + 1];
+        }
+        for (size_t cell = 0; cell < cells; ++cell) {
+            result.cell_starts_[cell + 1] += result.cell_starts_[cell];
+        }
+        result.ids_.resize(points.size());
+        std::vector<uint32_t> fill(result.cell_starts_.begin(), result.cell_starts_.end() - 1);
+        for (size_t i = 0; i < points.size(); ++i) {
+            result.ids_[fill[point_cells[i]]++] = points[i].first;
+        }
+        return result;
+    }
+
+    bool GridIndex::IsEmpty() const {
+        return ids_.empty();
+    }
+
+    bool GridIndex::IsValid(size_t point_count) const {
+        const auto is_positive = [](double value) {
+            return std::isfinite(value) && value > 0;
+        };
+        if (layout_.rows == 0 || layout_.cols == 0 || !is_positive(layout_.cell_lat) || !is_positive(layout_.cell_lng)
+            || !std::isfinite(layout_.min_lat) || !std::isfinite(layout_.min_lng)) {
+            return false;
+        }
+        if (cell_starts_.size() != static_cast<size_t>(layout_.rows) * layout_.cols + 1
+            || cell_starts_.front() != 0 || cell_starts_.back() != ids_.size()
+            || !std::is_sorted(cell_starts_.begin(), cell_starts_.end())) {
+            return false;
+        }
+        return std::all_of(ids_.begin(), ids_.end(), [point_count](uint32_t id) {
+            return id < point_count;
+            });
+    }
+
+    const GridIndex::Layout& GridIndex::GetLayout() const {
+        return layout_;
+    }
+
+    const std::vector<uint32_t>& GridIndex::GetCellStarts() const {
+        return cell_starts_;
+    }
+
+    const std::vector<uint32_t>& GridIndex::GetIds() const {
+        return ids_;
+    }
+
+    uint32_t GridIndex::RowOf(double lat) const {
+        const double row = std::floor((lat - layout_.min_lat) / layout_.cell_lat);
+        return static_cast<uint32_t>(std::clamp(row, 0.0, layout_.rows - 1.0));
+    }
+
+    uint32_t GridIndex::ColOf(double lng) const {
+        const double col = std::floor((lng - layout_.min_lng) / layout_.cell_lng);
+        return static_cast<uint32_t>(std::clamp(col, 0.0, layout_.cols - 1.0));
+    }
+
+    double GridIndex::GetMinCellSize() const {
+        const double max_lat = layout_.min_lat + layout_.rows * layout_.cell_lat;
+        const double widest_lat = std::max(std::abs(layout_.min_lat), std::abs(max_lat));
+        const double cell_height = layout_.cell_lat * METERS_PER_DEGREE;
+        const double cell_width = layout_.cell_lng * METERS_PER_DEGREE * std::cos(std::min(widest_lat, 90.0) * M_PI / 180.);
+        return std::max(0.0, std::min(cell_height, cell_width));
+    }
+
+}  // namespace geo
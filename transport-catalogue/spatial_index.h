@@ -0,0 +1,159 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <utility>
+#include <vector>
+#include "geo.h"
+
+namespace geo {
+
+    /*
+     * Равномерная сетка над ограничивающим прямоугольником точек.
+     * Номера точек хранятся плотно, упорядоченными по ячейкам (cell_starts_ задаёт границы ячеек),
+     * поэтому сетку можно сохранить в базе и загрузить без перестроения.
+     * Координаты в индексе не хранятся: запросы получают их через функцию get_coordinates(id).
+     */
+    class GridIndex {
+    public:
+        struct Layout {
+            double min_lat = 0.0;
+            double min_lng = 0.0;
+            double cell_lat = 1.0;
+            double cell_lng = 1.0;
+            uint32_t rows = 0;
+            uint32_t cols = 0;
+        };
+
+        GridIndex() = default;
+        // Массивы берутся как есть; пригодность данных из внешнего источника проверяет IsValid
+        GridIndex(Layout layout, std::vector<uint32_t> cell_starts, std::vector<uint32_t> ids);
+
+        static GridIndex Build(const std::vector<std::pair<uint32_t, Coordinates>>& points);
+
+        bool IsEmpty() const;
+        // Сетка из Build по point_count точкам всегда пригодна: размеры ячеек конечны и положительны,
+        // границы ячеек не убывают и покрывают все номера, а номера меньше point_count
+        bool IsValid(size_t point_count) const;
+        const Layout& GetLayout() const;
+        const std::vector<uint32_t>& GetCellStarts() const;
+        const std::vector<uint32_t>& GetIds() const;
+
+        // Точки внутри прямоугольника [min, max] в порядке обхода ячеек
+        template <typename GetCoordinates>
+        std::vector<uint32_t> FindInBox(Coordinates min, Coordinates max, GetCoordinates get_coordinates) const;
+
+        // До count ближайших точек не дальше max_distance метров, по возрастанию расстояния
+        template <typename GetCoordinates>
+        std::vector<std::pair<uint32_t, double>> FindNearest(Coordinates point, size_t count, double max_distance, GetCoordinates get_coordinates) const;
+        // То же, но только среди точек, для которых accept(id) истинно: поиск расширяется, пока таких не наберётся count
+        template <typename GetCoordinates, typename Accept>
+        std::vector<std::pair<uint32_t, double>> FindNearest(Coordinates point, size_t count, double max_distance, GetCoordinates get_coordinates, Accept accept) const;
+
+    private:
+        Layout layout_;
+        std::vector<uint32_t> cell_starts_;
+        std::vector<uint32_t> ids_;
+
+        uint32_t RowOf(double lat) const;
+        uint32_t ColOf(double lng) const;
+        // Нижняя оценка расстояния в метрах, приходящегося на одну ячейку по любой из осей
+        double GetMinCellSize() const;
+
+        template <typename Visitor>
+        void VisitCell(uint32_t row, uint32_t col, Visitor& visitor) const {
+            const size_t cell = static_cast<size_t>(row) * layout_.cols + col;
+            for (uint32_t i = cell_starts_[cell]; i < cell_starts_[cell + 1]; ++i) {
+                visitor(ids_[i]);
+            }
+        }
+    };
+
+    template <typename GetCoordinates>
+    std::vector<uint32_t> GridIndex::FindInBox(Coordinates min, Coordinates max, GetCoordinates get_coordinates) const {
+        std::vector<uint32_t> result;
+        if (IsEmpty() || min.lat > max.lat || min.lng > max.lng) {
+            return result;
+        }
+        auto visitor = [&](uint32_t id) {
+            const Coordinates coordinates = get_coordinates(id);
+            if (coordinates.lat >= min.lat && coordinates.lat <= max.lat && coordinates.lng >= min.lng && coordinates.lng <= max.lng) {
+                result.push_back(id);
+            }
+        };
+        const uint32_t max_row = RowOf(max.lat);
+        const uint32_t max_col = ColOf(max.lng);
+        for (uint32_t row = RowOf(min.lat); row <= max_row; ++row) {
+            for (uint32_t col = ColOf(min.lng); col <= max_col; ++col) {
+                VisitCell(row, col, visitor);
+            }
+        }
+        return result;
+    }
+
+    template <typename GetCoordinates>
+    std::vector<std::pair<uint32_t, double>> GridIndex::FindNearest(Coordinates point, size_t count, double max_distance, GetCoordinates get_coordinates) const {
+        return FindNearest(point, count, max_distance, get_coordinates, [](uint32_t) {
+            return true;
+            });
+    }
+
+    template <typename GetCoordinates, typename Accept>
+    std::vector<std::pair<uint32_t, double>> GridIndex::FindNearest(Coordinates point, size_t count, double max_distance, GetCoordinates get_coordinates, Accept accept) const {
+        using Candidate = std::pair<double, uint32_t>;
+        // Вершина кучи — самый дальний из уже найденных кандидатов
+        std::priority_queue<Candidate> best;
+        if (IsEmpty() || count == 0) {
+            return {};
+        }
+        auto visitor = [&](uint32_t id) {
+            if (!accept(id)) {
+                return;
+            }
+            const double distance = ComputeDistance(point, get_coordinates(id));
+            if (distance > max_distance) {
+                return;
+            }
+            if (best.size() < count) {
+                best.push({ distance, id });
+            }
+            else if (Candidate{ distance, id } < best.top()) {
+                best.pop();
+                best.push({ distance, id });
+            }
+        };
+
+        const int64_t center_row = RowOf(point.lat);
+        const int64_t center_col = ColOf(point.lng);
+        const int64_t max_ring = std::max(layout_.rows, layout_.cols);
+        const double cell_size = GetMinCellSize();
+        // Обходим кольца ячеек вокруг ячейки запроса, пока следующее кольцо может содержать более близкие точки
+        for (int64_t ring = 0; ring <= max_ring; ++ring) {
+            const double ring_min_distance = std::max<int64_t>(ring - 1, 0) * cell_size;
+            if (ring_min_distance > max_distance || (best.size() == count && ring_min_distance > best.top().first)) {
+                break;
+            }
+            for (int64_t row = center_row - ring; row <= center_row + ring; ++row) {
+                if (row < 0 || row >= layout_.rows) {
+                    continue;
+                }
+                const bool is_edge_row = row == center_row - ring || row == center_row + ring;
+                const int64_t col_step = is_edge_row ? 1 : 2 * ring;
+                for (int64_t col = center_col - ring; col <= center_col + ring; col += std::max<int64_t>(col_step, 1)) {
+                    if (col >= 0 && col < layout_.cols) {
+                        VisitCell(static_cast<uint32_t>(row), static_cast<uint32_t>(col), visitor);
+                    }
+                }
+            }
+        }
+
+        std::vector<std::pair<uint32_t, double>> result(best.size());
+        for (auto it = result.rbegin(); it != result.rend(); ++it) {
+            *it = { best.top().second, best.top().first };
+            best.pop();
+        }
+        return result;
+    }
+
+}  // namespace geo
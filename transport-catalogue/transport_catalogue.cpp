@@ -1,31 +1,53 @@
+#include <algorithm>
+#include <stdexcept>
 #include <utility>
 #include <unordered_set>
 #include "transport_catalogue.h"
 
-void transport_catalogue::TransportCatalogue::AddStop(const std::string& name, double latitude, double longitude, int id) {
+using namespace std::literals;
+
+void transport_catalogue::TransportCatalogue::AddStop(std::string_view name, double latitude, double longitude) {
     geo::Coordinates coord;
     coord.lat = latitude;
     coord.lng = longitude;
     domain::Stop new_stop;
-    new_stop.name = name;
+    new_stop.name = names_.Intern(name);
     new_stop.coordinates = coord;
-    new_stop.id_ = id;
+    new_stop.id = stops_.size();
     stops_.push_back(std::move(new_stop));
-    stopname_to_stop_[stops_.back().name] = &stops_.back();
+    if (!is_frozen_) {
+        stopname_to_stop_[stops_.back().name] = &stops_.back();
+    }
     stopname_to_busname_[&stops_.back()];
 }
 
 void transport_catalogue::TransportCatalogue::AddBus(const std::string& name, const std::vector<std::string>& stops, bool rounded) {
-    domain::Bus new_bus;
-    new_bus.name = name;
+    std::vector<const domain::Stop*> route;
+    route.reserve(stops.size());
     for (const std::string& stop_name : stops) {
-        new_bus.route.push_back(stopname_to_stop_.at(stop_name));
+        route.push_back(GetStop(stop_name));
     }
+    AddBus(std::string_view(name), route, rounded);
+}
+
+void transport_catalogue::TransportCatalogue::AddBus(std::string_view name, const std::vector<const domain::Stop*>& stops, bool rounded) {
+    domain::Bus new_bus;
+    new_bus.name = names_.Intern(name);
+    new_bus.route = stops;
     new_bus.is_rounded = rounded;
+    new_bus.id = buses_.size();
     buses_.push_back(std::move(new_bus));
-    busname_to_bus_[buses_.back().name] = &buses_.back();
+    if (!is_frozen_) {
+        busname_to_bus_[buses_.back().name] = &buses_.back();
+    }
+    // Упорядочиваются один раз в SortByNames, когда все маршруты уже добавлены
+    sorted_buses_.push_back(&buses_.back());
     for (const auto& stop : buses_.back().route) {
-        stopname_to_busname_[stop].insert(buses_.back().name);
+        auto& buses_on_stop = stopname_to_busname_[stop];
+        if (buses_on_stop.empty()) {
+            sorted_stops_on_routes_.push_back(stop);
+        }
+        buses_on_stop.insert(buses_.back().name);
     }
     auto result = ComputeDistanceBetweenStops();
     buses_.back().distance_real = result.first;
@@ -79,14 +101,14 @@ void transport_catalogue::TransportCatalogue::AddBus(const std::string& name, co
 }
 
 const ::std::optional<::std::set<std::string_view>> transport_catalogue::TransportCatalogue::BusesOnStop(const ::std::string_view& stop_name) const {
-    if (stopname_to_stop_.count(stop_name) == 0) {
+    if (FindStop(stop_name) == nullptr) {
         return {};
     }
     ::std::set<std::string_view> result;
-    if (stopname_to_busname_.at(stopname_to_stop_.at(stop_name)).size() == 0) {
+    if (stopname_to_busname_.at(GetStop(stop_name)).size() == 0) {
         return result;
     }
-    for (const auto& bus : stopname_to_busname_.at(stopname_to_stop_.at(stop_name))) {
+    for (const auto& bus : stopname_to_busname_.at(GetStop(stop_name))) {
         result.insert(bus);
     }
     return result;
@@ -94,16 +116,16 @@ const ::std::optional<::std::set<std::string_view>> transport_catalogue::Transpo
 
 const ::std::set<std::string_view> transport_catalogue::TransportCatalogue::GetAllBusesNames() const {
     ::std::set<std::string_view> result;
-    for (const auto [key, _] : busname_to_bus_) {
-        result.insert(key);
+    for (const domain::Bus* bus : sorted_buses_) {
+        result.insert(bus->name);
     }
     return result;
 }
 
 const ::std::vector<std::string_view> transport_catalogue::TransportCatalogue::GetBusRoute(const ::std::string_view& bus_name) const {
     ::std::vector<std::string_view> result;
-    if (busname_to_bus_.count(bus_name) != 0) {
-        for (const auto& stop : busname_to_bus_.at(bus_name)->route) {
+    if (FindBus(bus_name) != nullptr) {
+        for (const auto& stop : GetBus(bus_name)->route) {
             result.push_back(stop->name);
         }
     }
@@ -112,83 +134,244 @@ const ::std::vector<std::string_view> transport_catalogue::TransportCatalogue::G
 
 const geo::Coordinates transport_catalogue::TransportCatalogue::GetStopCoordinates(const std::string_view& stop_name) const {
     geo::Coordinates result;
-    if (stopname_to_stop_.at(stop_name) != 0) {
-        result = stopname_to_stop_.at(stop_name)->coordinates;
+    if (const domain::Stop* stop = GetStop(stop_name); stop != nullptr) {
+        result = stop->coordinates;
     }
     return result;
 }
 
 const ::std::vector<geo::Coordinates> transport_catalogue::TransportCatalogue::GetAllStopCoordinates() const {
     ::std::vector<geo::Coordinates> result;
-    for (const auto& [name, stop] : stopname_to_stop_) {
-        if (stopname_to_busname_.at(stop).size() != 0) {
-            result.push_back(stopname_to_stop_.at(name)->coordinates);
-        }
+    result.reserve(sorted_stops_on_routes_.size());
+    for (const domain::Stop* stop : sorted_stops_on_routes_) {
+        result.push_back(stop->coordinates);
     }
     return result;
 }
 
-const ::std::optional<domain::Statistics> transport_catalogue::TransportCatalogue::GetBusInfo(const std::string_view& bus) const {
-    if (busname_to_bus_.count(bus) == 0) {
+const ::std::optional<domain::Statistics> transport_catalogue::TransportCatalogue::GetBusInfo(const std::string_view& bus_name) const {
+    const domain::Bus* bus = FindBus(bus_name);
+    if (bus == nullptr) {
         return {};
     }
     domain::Statistics result;
     result.found = true;
-    if (busname_to_bus_.at(bus)->is_rounded == false) {
+    if (bus->is_rounded == false) {
         result.is_rounded = false;
-        result.stops_count = busname_to_bus_.at(bus)->route.size();
+        result.stops_count = bus->route.size();
         result.stops_count = (result.stops_count * 2) - 1;
     }
     else {
         result.is_rounded = true;
-        result.stops_count = busname_to_bus_.at(bus)->route.size();
+        result.stops_count = bus->route.size();
     }
     int unique_count = 0;
     std::unordered_set<std::string_view> unique_stops_names;
-    for (const auto& stop : busname_to_bus_.at(bus)->route) {
+    for (const auto& stop : bus->route) {
         if (unique_stops_names.count(stop->name) == 0) {
             unique_stops_names.insert(stop->name);
             ++unique_count;
         }
     }
     result.unique_stops_count = unique_count;
-    result.distance = busname_to_bus_.at(bus)->distance_real;
-    result.curvature = busname_to_bus_.at(bus)->distance_real / busname_to_bus_.at(bus)->distance_ideal;
+    result.distance = bus->distance_real;
+    result.curvature = bus->distance_real / bus->distance_ideal;
     return result;
 }
 
 void transport_catalogue::TransportCatalogue::AddStopDistances(const std::string& stop_name, const std::vector<std::pair<std::string, int>>& stops_and_distances) {
     for (const auto& info : stops_and_distances) {
-        stops_to_distance[{stopname_to_stop_[stop_name], stopname_to_stop_[info.first]}] = info.second;
+        stops_to_distance[{ FindStop(stop_name), FindStop(info.first) }] = info.second;
     }
 }
 
-const domain::Stop& transport_catalogue::TransportCatalogue::GetStopByName(const ::std::string_view& stop_name) const {
-    return *(stopname_to_stop_.at(stop_name));
-}
-
 size_t transport_catalogue::TransportCatalogue::GetAllStopsCount() const {
-    return stopname_to_stop_.size();
+    return stops_.size();
 }
 
 int transport_catalogue::TransportCatalogue::GetStopToStopDistance(const std::string_view& from, const std::string_view& to) const {
-    if (stops_to_distance.count({ stopname_to_stop_.at(from), stopname_to_stop_.at(to) }) != 0) {
-        return stops_to_distance.at({ stopname_to_stop_.at(from), stopname_to_stop_.at(to) });
+    return GetStopToStopDistance(GetStop(from), GetStop(to));
+}
+
+int transport_catalogue::TransportCatalogue::GetStopToStopDistance(const domain::Stop* from, const domain::Stop* to) const {
+    if (auto it = stops_to_distance.find({ from, to }); it != stops_to_distance.end()) {
+        return it->second;
+    }
+    if (auto it = stops_to_distance.find({ to, from }); it != stops_to_distance.end()) {
+        return it->second;
+    }
+    return std::abs(ComputeDistance(from->coordinates, to->coordinates));
+}
+
+void transport_catalogue::TransportCatalogue::AddStopToStopDistance(const ::std::string& from_stop, const ::std::string& to_stop, int distance) {
+    stops_to_distance[{GetStop(from_stop), GetStop(to_stop)}] = distance;
+}
+
+void transport_catalogue::TransportCatalogue::AddStopToStopDistance(const domain::Stop* from_stop, const domain::Stop* to_stop, int distance) {
+    stops_to_distance[{from_stop, to_stop}] = distance;
+}
+
+std::string_view transport_catalogue::TransportCatalogue::AdoptNames(std::string&& names) {
+    return names_.Adopt(std::move(names));
+}
+
+void transport_catalogue::TransportCatalogue::SortByNames() {
+    std::sort(sorted_buses_.begin(), sorted_buses_.end(), [](const domain::Bus* lhs, const domain::Bus* rhs) {
+        return lhs->name < rhs->name;
+        });
+    std::sort(sorted_stops_on_routes_.begin(), sorted_stops_on_routes_.end(), [](const domain::Stop* lhs, const domain::Stop* rhs) {
+        return lhs->name < rhs->name;
+        });
+}
+
+const std::deque<domain::Stop>& transport_catalogue::TransportCatalogue::GetStops() const {
+    return stops_;
+}
+
+const std::deque<domain::Bus>& transport_catalogue::TransportCatalogue::GetBuses() const {
+    return buses_;
+}
+
+const domain::Bus* transport_catalogue::TransportCatalogue::FindBus(std::string_view bus_name) const {
+    if (is_frozen_) {
+        const uint32_t id = buses_index_.FindCandidate(bus_name);
+        return id < buses_.size() && buses_[id].name == bus_name ? &buses_[id] : nullptr;
+    }
+    auto it = busname_to_bus_.find(bus_name);
+    return it == busname_to_bus_.end() ? nullptr : it->second;
+}
+
+const domain::Stop* transport_catalogue::TransportCatalogue::FindStop(std::string_view stop_name) const {
+    if (is_frozen_) {
+        const uint32_t id = stops_index_.FindCandidate(stop_name);
+        return id < stops_.size() && stops_[id].name == stop_name ? &stops_[id] : nullptr;
+    }
+    auto it = stopname_to_stop_.find(stop_name);
+    return it == stopname_to_stop_.end() ? nullptr : it->second;
+}
+
+const domain::Bus* transport_catalogue::TransportCatalogue::GetBus(std::string_view bus_name) const {
+    const domain::Bus* bus = FindBus(bus_name);
+    if (bus == nullptr) {
+        throw std::out_of_range("Unknown bus "s + std::string(bus_name));
     }
-    if (stops_to_distance.count({ stopname_to_stop_.at(to), stopname_to_stop_.at(from) }) != 0) {
-        return stops_to_distance.at({ stopname_to_stop_.at(to), stopname_to_stop_.at(from) });
+    return bus;
+}
+
+const domain::Stop* transport_catalogue::TransportCatalogue::GetStop(std::string_view stop_name) const {
+    const domain::Stop* stop = FindStop(stop_name);
+    if (stop == nullptr) {
+        throw std::out_of_range("Unknown stop "s + std::string(stop_name));
+    }
+    return stop;
+}
+
+void transport_catalogue::TransportCatalogue::Freeze() {
+    std::vector<std::pair<std::string_view, uint32_t>> stops;
+    stops.reserve(stopname_to_stop_.size());
+    for (const auto& [name, stop] : stopname_to_stop_) {
+        stops.emplace_back(name, static_cast<uint32_t>(stop->id));
+    }
+    std::vector<std::pair<std::string_view, uint32_t>> buses;
+    buses.reserve(busname_to_bus_.size());
+    for (const auto& [name, bus] : busname_to_bus_) {
+        buses.emplace_back(name, static_cast<uint32_t>(bus->id));
+    }
+    SetNameIndexes(domain::FrozenNameIndex::Build(stops), domain::FrozenNameIndex::Build(buses));
+    BuildStopsGrid();
+    SortByNames();
+}
+
+void transport_catalogue::TransportCatalogue::SetNameIndexes(domain::FrozenNameIndex stops_index, domain::FrozenNameIndex buses_index) {
+    stops_index_ = std::move(stops_index);
+    buses_index_ = std::move(buses_index);
+    is_frozen_ = true;
+    stopname_to_stop_.clear();
+    busname_to_bus_.clear();
+}
+
+const domain::FrozenNameIndex& transport_catalogue::TransportCatalogue::GetStopsIndex() const {
+    return stops_index_;
+}
+
+const domain::FrozenNameIndex& transport_catalogue::TransportCatalogue::GetBusesIndex() const {
+    return buses_index_;
+}
+
+transport_catalogue::TransportCatalogue::BusesRange transport_catalogue::TransportCatalogue::GetSortedBuses() const {
+    return ranges::AsRange(sorted_buses_);
+}
+
+transport_catalogue::TransportCatalogue::StopsRange transport_catalogue::TransportCatalogue::GetSortedStopsOnRoutes() const {
+    return ranges::AsRange(sorted_stops_on_routes_);
+}
+
+std::optional<transport_catalogue::TransportCatalogue::BusNamesRange> transport_catalogue::TransportCatalogue::BusesOnStopView(std::string_view stop_name) const {
+    const domain::Stop* stop = FindStop(stop_name);
+    if (stop == nullptr) {
+        return {};
     }
-    return std::abs(ComputeDistance(stopname_to_stop_.at(from)->coordinates, stopname_to_stop_.at(to)->coordinates));
+    return ranges::AsRange(stopname_to_busname_.at(stop));
+}
+
+const transport_catalogue::TransportCatalogue::StopsDistances& transport_catalogue::TransportCatalogue::GetStopToStopDistances() const {
+    return stops_to_distance;
+}
+
+void transport_catalogue::TransportCatalogue::BuildStopsGrid() {
+    std::vector<std::pair<uint32_t, geo::Coordinates>> points;
+    points.reserve(stops_.size());
+    for (const domain::Stop& stop : stops_) {
+        points.emplace_back(static_cast<uint32_t>(stop.id), stop.coordinates);
+    }
+    stops_grid_ = geo::GridIndex::Build(points);
+}
+
+void transport_catalogue::TransportCatalogue::SetStopsGrid(geo::GridIndex grid) {
+    stops_grid_ = std::move(grid);
 }
 
-bool transport_catalogue::TransportCatalogue::IsRoundBus(const ::std::string_view& bus_name) const {
-    return busname_to_bus_.at(bus_name)->is_rounded;
+const geo::GridIndex& transport_catalogue::TransportCatalogue::GetStopsGrid() const {
+    return stops_grid_;
 }
 
-bool transport_catalogue::TransportCatalogue::CheckStopValidity(const ::std::string_view& stop_name) const {
-    return stopname_to_stop_.count(stop_name);
+std::vector<std::pair<const domain::Stop*, double>> transport_catalogue::TransportCatalogue::FindNearestStops(geo::Coordinates point, size_t count, double max_distance) const {
+    auto found = stops_grid_.FindNearest(point, count, max_distance, [this](uint32_t id) {
+        return stops_[id].coordinates;
+        });
+    std::vector<std::pair<const domain::Stop*, double>> result;
+    result.reserve(found.size());
+    for (const auto& [id, distance] : found) {
+        result.emplace_back(&stops_[id], distance);
+    }
+    return result;
 }
 
-const ::std::unordered_map<::std::string_view, const domain::Bus*> transport_catalogue::TransportCatalogue::GetAllBuses() const {
-    return busname_to_bus_;
+std::vector<std::pair<const domain::Stop*, double>> transport_catalogue::TransportCatalogue::FindNearestServedStops(geo::Coordinates point, size_t count, double max_distance) const {
+    auto found = stops_grid_.FindNearest(point, count, max_distance, [this](uint32_t id) {
+        return stops_[id].coordinates;
+        }, [this](uint32_t id) {
+            return !stopname_to_busname_.at(&stops_[id]).empty();
+        });
+    std::vector<std::pair<const domain::Stop*, double>> result;
+    result.reserve(found.size());
+    for (const auto& [id, distance] : found) {
+        result.emplace_back(&stops_[id], distance);
+    }
+    return result;
+}
+
+std::vector<const domain::Stop*> transport_catalogue::TransportCatalogue::FindStopsInBox(geo::Coordinates min, geo::Coordinates max) const {
+    auto found = stops_grid_.FindInBox(min, max, [this](uint32_t id) {
+        return stops_[id].coordinates;
+        });
+    std::vector<const domain::Stop*> result;
+    result.reserve(found.size());
+    for (uint32_t id : found) {
+        result.push_back(&stops_[id]);
+    }
+    std::sort(result.begin(), result.end(), [](const domain::Stop* lhs, const domain::Stop* rhs) {
+        return lhs->name < rhs->name;
+        });
+    return result;
 }
@@ -1,4 +1,8 @@
 #include "transport_router.h"
+#include "metrics.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
 
 using namespace transport_router;
 using namespace std::literals;
@@ -13,16 +17,16 @@ void TransportRouter::SetBusVelocity(double bus_velocity) {
 }
 
 void TransportRouter::BuildGraph(const transport_catalogue::TransportCatalogue& catalogue) {
+	static metrics::Histogram& histogram = metrics::GetHistogram("router.build_graph");
+	const metrics::ScopedTimer timer(histogram);
 	graph_ = graph::DirectedWeightedGraph<double>(static_cast<size_t>(catalogue.GetAllStopsCount() * 2));
-	for (const auto& [bus_name, bus] : catalogue.GetAllBuses()) {
+	for (const domain::Bus* bus : catalogue.GetSortedBuses()) {
 		for (const auto& stop : bus->route) {
 			if (stop_to_vertexId.count(stop->name) == 0) {
-				stop_to_vertexId[stop->name] = stop_to_vertexId.size();
-			}
-			if (stop_to_vertexId.count(stop->name + "_mirror"s) == 0) {
-				stop_to_vertexId[stop->name + "_mirror"s] = stop_to_vertexId.size();
-				auto edgeId = graph_.value().AddEdge({ stop_to_vertexId.at(stop->name), stop_to_vertexId.at(stop->name + "_mirror"s), bus_wait_time_ * 1.0 });
-				id_to_edge_info[edgeId] = { "Wait"s, stop->name, ""s, bus_wait_time_ * 1.0, 0 };
+				const size_t vertex_id = stop_to_vertexId.size() * 2;
+				stop_to_vertexId[stop->name] = vertex_id;
+				auto edgeId = graph_.value().AddEdge({ vertex_id, vertex_id + 1, bus_wait_time_ * 1.0 });
+				id_to_edge_info[edgeId] = { "Wait"sv, stop->name, ""sv, bus_wait_time_ * 1.0, 0 };
 			}
 		}
 		for (auto it_begin = bus->route.begin(); it_begin != bus->route.end(); ++it_begin) {
@@ -31,13 +35,13 @@ void TransportRouter::BuildGraph(const transport_catalogue::TransportCatalogue&
 			int stops_passed = 0;
 			auto prev_stop = *it_begin;
 			for (auto it_end = std::next(it_begin); it_end != bus->route.end(); ++it_end) {
-				time_forward += ((catalogue.GetStopToStopDistance(prev_stop->name, (*it_end)->name) * 1.0) / mph) / 60;
-				time_backward += ((catalogue.GetStopToStopDistance((*it_end)->name, prev_stop->name) * 1.0) / mph) / 60;
-				auto edgeId = graph_.value().AddEdge({ stop_to_vertexId.at((*it_begin)->name + "_mirror"s), stop_to_vertexId.at((*it_end)->name), time_forward });
-				id_to_edge_info[edgeId] = { "Bus"s, ""s, bus->name, time_forward, ++stops_passed };
+				time_forward += ((catalogue.GetStopToStopDistance(prev_stop, *it_end) * 1.0) / mph) / 60;
+				time_backward += ((catalogue.GetStopToStopDistance(*it_end, prev_stop) * 1.0) / mph) / 60;
+				auto edgeId = graph_.value().AddEdge({ stop_to_vertexId.at((*it_begin)->name) + 1, stop_to_vertexId.at((*it_end)->name), time_forward });
+				id_to_edge_info[edgeId] = { "Bus"sv, ""sv, bus->name, time_forward, ++stops_passed };
 				if (!bus->is_rounded) {
-					edgeId = graph_.value().AddEdge({ stop_to_vertexId.at((*it_end)->name + "_mirror"s), stop_to_vertexId.at((*it_begin)->name), time_backward });
-					id_to_edge_info[edgeId] = { "Bus"s, ""s, bus->name, time_backward, stops_passed };
+					edgeId = graph_.value().AddEdge({ stop_to_vertexId.at((*it_end)->name) + 1, stop_to_vertexId.at((*it_begin)->name), time_backward });
+					id_to_edge_info[edgeId] = { "Bus"sv, ""sv, bus->name, time_backward, stops_passed };
 				}
 				prev_stop = *it_end;
 			}
@@ -45,13 +49,38 @@ void TransportRouter::BuildGraph(const transport_catalogue::TransportCatalogue&
 	}
 }
 
-std::optional<std::vector<transport_router::EdgeInfo>> TransportRouter::BuildRoute(const transport_catalogue::TransportCatalogue& catalogue, const std::string& from, const std::string& to) {
+void TransportRouter::SetPedestrianVelocity(double pedestrian_velocity) {
+	pedestrian_velocity_ = pedestrian_velocity;
+}
+
+void TransportRouter::Prepare(const transport_catalogue::TransportCatalogue& catalogue) {
+	if (graph_) {
+		return;
+	}
+	BuildGraph(catalogue);
+	static metrics::Counter& vertex_counter = metrics::GetCounter("router.vertices");
+	static metrics::Counter& edge_counter = metrics::GetCounter("router.edges");
+	vertex_counter.Set(graph_->GetVertexCount());
+	edge_counter.Set(graph_->GetEdgeCount());
+	if (graph_->GetEdgeCount() > 0) {
+		static metrics::Histogram& histogram = metrics::GetHistogram("router.precompute");
+		const metrics::ScopedTimer timer(histogram);
+		router_ = std::make_unique<graph::Router<double>>(graph::Router(graph_.value()));
+	}
+}
+
+bool TransportRouter::IsPrepared() const {
+	return graph_.has_value();
+}
+
+void TransportRouter::CheckPrepared() const {
 	if (!graph_) {
-		BuildGraph(catalogue);
-		if (graph_->GetEdgeCount() > 0) {
-			router_ = std::make_unique<graph::Router<double>>(graph::Router(graph_.value()));
-		}
+		throw std::logic_error("TransportRouter::Prepare must be called before route queries");
 	}
+}
+
+std::optional<std::vector<transport_router::EdgeInfo>> TransportRouter::BuildRoute(std::string_view from, std::string_view to) const {
+	CheckPrepared();
 	if (stop_to_vertexId.count(from) == 0 || stop_to_vertexId.count(to) == 0) {
 		return {};
 	}
@@ -74,9 +103,65 @@ std::optional<std::vector<transport_router::EdgeInfo>> TransportRouter::BuildRou
 	}
 }
 
+double TransportRouter::ComputeWalkTime(geo::Coordinates from, geo::Coordinates to) const {
+	return ((geo::ComputeDistance(from, to) / (pedestrian_velocity_ * ((5 * 1.0) / (18 * 1.0)))) / 60);
+}
+
+std::vector<TransportRouter::WalkLeg> TransportRouter::SnapToStops(const transport_catalogue::TransportCatalogue& catalogue, geo::Coordinates point, size_t snap_count) const {
+	std::vector<WalkLeg> legs;
+	// Остановки без маршрутов не попадают в граф, поэтому отбрасываются ещё при поиске и не вытесняют обслуживаемые
+	for (const auto& [stop, distance] : catalogue.FindNearestServedStops(point, snap_count, std::numeric_limits<double>::infinity())) {
+		legs.push_back({ stop->name, stop_to_vertexId.at(stop->name), ComputeWalkTime(point, stop->coordinates) });
+	}
+	return legs;
+}
+
+std::vector<transport_router::EdgeInfo> TransportRouter::BuildRouteFromPoint(const transport_catalogue::TransportCatalogue& catalogue, geo::Coordinates from, geo::Coordinates to, size_t snap_count) const {
+	CheckPrepared();
+	std::optional<graph::Router<double>::MultiRouteInfo> route;
+	std::vector<WalkLeg> from_legs;
+	std::vector<WalkLeg> to_legs;
+	if (router_) {
+		from_legs = SnapToStops(catalogue, from, snap_count);
+		to_legs = SnapToStops(catalogue, to, snap_count);
+		std::vector<std::pair<graph::VertexId, double>> sources;
+		for (const WalkLeg& leg : from_legs) {
+			sources.emplace_back(leg.vertex, leg.time);
+		}
+		std::vector<std::pair<graph::VertexId, double>> targets;
+		for (const WalkLeg& leg : to_legs) {
+			targets.emplace_back(leg.vertex, leg.time);
+		}
+		route = router_->BuildRoute(sources, targets);
+	}
+	std::vector<EdgeInfo> result;
+	// Если дойти пешком не дольше, чем ехать, транспорт не нужен
+	const double walk_time = ComputeWalkTime(from, to);
+	if (!route || walk_time <= route->weight) {
+		result.push_back({ "Walk"sv, ""sv, ""sv, walk_time, 0 });
+		return result;
+	}
+	auto find_leg = [](const std::vector<WalkLeg>& legs, graph::VertexId vertex) {
+		return *std::find_if(legs.begin(), legs.end(), [vertex](const WalkLeg& leg) {
+			return leg.vertex == vertex;
+			});
+	};
+	const WalkLeg& first_leg = find_leg(from_legs, route->from);
+	const WalkLeg& last_leg = find_leg(to_legs, route->to);
+	result.push_back({ "Walk"sv, first_leg.stop_name, ""sv, first_leg.time, 0 });
+	for (const auto& res : route->edges) {
+		result.push_back(id_to_edge_info.at(res));
+	}
+	result.push_back({ "Walk"sv, last_leg.stop_name, ""sv, last_leg.time, 0 });
+	return result;
+}
+
 int TransportRouter::GetBusWaitTime() const {
 	return bus_wait_time_;
 }
 double TransportRouter::GetBusVelocity() const {
 	return bus_velocity_;
 }
+double TransportRouter::GetPedestrianVelocity() const {
+	return pedestrian_velocity_;
+}
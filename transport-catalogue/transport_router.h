@@ -5,31 +5,61 @@
 #include "transport_catalogue.h"
 
 namespace transport_router {
+	// Названия ссылаются на имена, хранящиеся в каталоге
 	struct EdgeInfo {
-		std::string type;
-		std::string stop_name;
-		std::string bus;
+		std::string_view type;
+		std::string_view stop_name;
+		std::string_view bus;
 		double time;
 		int span_count;
 	};
 
+	struct RoutingSettings {
+		int bus_wait_time = 0;
+		double bus_velocity = 0;
+		// Скорость пешехода в км/ч, используется для подхода к остановкам в RouteFromPoint
+		double pedestrian_velocity = 5.0;
+	};
+
 	class TransportRouter {
 	public:
 		TransportRouter() = default;
 		void SetBusWaitTime(int bus_wait_time);
 		void SetBusVelocity(double bus_velocity);
+		void SetPedestrianVelocity(double pedestrian_velocity);
 		int GetBusWaitTime() const;
 		double GetBusVelocity() const;
-		void BuildGraph(const transport_catalogue::TransportCatalogue& catalogue);
-		std::optional<std::vector<transport_router::EdgeInfo>> BuildRoute(const transport_catalogue::TransportCatalogue& catalogue, const std::string& from, const std::string& to);
+		double GetPedestrianVelocity() const;
+		// Строит граф и маршрутизатор по заданным настройкам; повторный вызов ничего не делает.
+		// После подготовки объект не меняется, и запросы маршрутов можно выполнять из нескольких потоков
+		void Prepare(const transport_catalogue::TransportCatalogue& catalogue);
+		bool IsPrepared() const;
+		// Запросы маршрутов требуют вызова Prepare, иначе бросается std::logic_error
+		std::optional<std::vector<transport_router::EdgeInfo>> BuildRoute(std::string_view from, std::string_view to) const;
+		// Начало и конец привязываются к snap_count ближайшим остановкам, к ним добавляется пеший участок.
+		// Лучшая пара остановок выбирается одним поиском по всем источникам и целям сразу
+		std::vector<transport_router::EdgeInfo> BuildRouteFromPoint(const transport_catalogue::TransportCatalogue& catalogue, geo::Coordinates from, geo::Coordinates to, size_t snap_count) const;
 	private:
+		struct WalkLeg {
+			std::string_view stop_name;
+			graph::VertexId vertex;
+			double time;
+		};
+
 		int bus_wait_time_ = 0;
 		double bus_velocity_ = 0;
 		double mph;
+		double pedestrian_velocity_ = RoutingSettings{}.pedestrian_velocity;
 		std::unordered_map<int, EdgeInfo> id_to_edge_info;
-		std::unordered_map<std::string, size_t> stop_to_vertexId;
+		// Вершина ожидания на остановке имеет номер на единицу больше вершины самой остановки
+		std::unordered_map<std::string_view, size_t> stop_to_vertexId;
 		std::optional<graph::DirectedWeightedGraph<double>> graph_;
 		std::unique_ptr<graph::Router<double>> router_;
+
+		void BuildGraph(const transport_catalogue::TransportCatalogue& catalogue);
+		void CheckPrepared() const;
+		double ComputeWalkTime(geo::Coordinates from, geo::Coordinates to) const;
+		std::vector<WalkLeg> SnapToStops(const transport_catalogue::TransportCatalogue& catalogue, geo::Coordinates point, size_t snap_count) const;
 	};
 
 } //namespace transport_router  